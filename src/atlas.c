@@ -0,0 +1,73 @@
+#include "atlas.h"
+#include "global.h"
+
+#include <stdlib.h>
+
+/* Gap between images, so that filtering does not pick up neighbours */
+static const int GAP = 1;
+
+static SDL_Texture **pages = NULL;
+static int n_pages = 0;
+/* The shelf being filled on the last page */
+static int shelf_x, shelf_y, shelf_h;
+
+static SDL_Texture *create_page(int w, int h)
+{
+    SDL_Texture *tex = SDL_CreateTexture(g_renderer, SDL_PIXELFORMAT_ARGB8888,
+        SDL_TEXTUREACCESS_STATIC, w, h);
+    SDL_SetTextureBlendMode(tex, SDL_BLENDMODE_BLEND);
+    /* Contents of a new texture are undefined */
+    void *zero = calloc((size_t)w * h, 4);
+    SDL_UpdateTexture(tex, NULL, zero, w * 4);
+    free(zero);
+
+    pages = realloc(pages, sizeof(SDL_Texture *) * (n_pages + 1));
+    pages[n_pages++] = tex;
+    return tex;
+}
+
+texture atlas_add(SDL_Surface *sf)
+{
+    texture ret = (texture){NULL, (SDL_Rect){0, 0, sf->w, sf->h}};
+    SDL_Surface *conv = NULL;
+    if (sf->format->format != SDL_PIXELFORMAT_ARGB8888)
+        sf = conv = SDL_ConvertSurfaceFormat(sf, SDL_PIXELFORMAT_ARGB8888, 0);
+
+    if (sf->w > ATLAS_PAGE || sf->h > ATLAS_PAGE) {
+        /* A texture of its own, which does not take new images;
+         * the next one goes to a new page */
+        ret.sdl_tex = create_page(sf->w, sf->h);
+        shelf_x = shelf_y = ATLAS_PAGE;
+        shelf_h = 0;
+    } else {
+        if (n_pages > 0 && shelf_x + sf->w > ATLAS_PAGE) {
+            /* Start a new shelf */
+            shelf_y += shelf_h + GAP;
+            shelf_x = shelf_h = 0;
+        }
+        if (n_pages == 0 || shelf_y + sf->h > ATLAS_PAGE) {
+            create_page(ATLAS_PAGE, ATLAS_PAGE);
+            shelf_x = shelf_y = shelf_h = 0;
+        }
+        ret.sdl_tex = pages[n_pages - 1];
+        ret.range.x = shelf_x;
+        ret.range.y = shelf_y;
+        shelf_x += sf->w + GAP;
+        if (shelf_h < sf->h) shelf_h = sf->h;
+    }
+
+    if (SDL_MUSTLOCK(sf)) SDL_LockSurface(sf);
+    SDL_UpdateTexture(ret.sdl_tex, &ret.range, sf->pixels, sf->pitch);
+    if (SDL_MUSTLOCK(sf)) SDL_UnlockSurface(sf);
+    if (conv != NULL) SDL_FreeSurface(conv);
+    return ret;
+}
+
+void atlas_release()
+{
+    int i;
+    for (i = 0; i < n_pages; ++i) SDL_DestroyTexture(pages[i]);
+    free(pages);
+    pages = NULL;
+    n_pages = 0;
+}
@@ -0,0 +1,19 @@
+/* Small images packed into shared textures */
+
+#ifndef _ATLAS_H
+#define _ATLAS_H
+
+#include "resources.h"
+
+#include <SDL.h>
+
+/* Size of each texture */
+#define ATLAS_PAGE  1024
+
+/* Uploads the surface to the first page with room left;
+ * images on a page are placed in rows (shelves) of similar heights.
+ * Images too large for a page get a texture of their own. */
+texture atlas_add(SDL_Surface *sf);
+void atlas_release();
+
+#endif
@@ -0,0 +1,87 @@
+#include "batch.h"
+#include "global.h"
+
+#include <stdbool.h>
+
+struct quad {
+    SDL_Rect src, dst;
+    SDL_Color c;
+};
+
+static SDL_Texture *cur_tex = NULL;
+static int n = 0;
+static struct quad quads[BATCH_CAP];
+
+static inline void push(SDL_Texture *tex, const SDL_Rect *src, const SDL_Rect *dst,
+    SDL_Color c)
+{
+    if (n > 0 && (tex != cur_tex || n == BATCH_CAP)) batch_flush();
+    cur_tex = tex;
+    if (src != NULL) {
+        quads[n].src = *src;
+    } else {
+        quads[n].src = (SDL_Rect){0, 0, 0, 0};
+        if (tex != NULL) SDL_QueryTexture(tex, NULL, NULL,
+            &quads[n].src.w, &quads[n].src.h);
+    }
+    quads[n].dst = *dst;
+    quads[n].c = c;
+    ++n;
+}
+
+void batch_copy(SDL_Texture *tex, const SDL_Rect *src, const SDL_Rect *dst,
+    SDL_Color c)
+{
+    if (tex == NULL) return;
+    push(tex, src, dst, c);
+}
+
+void batch_fill(const SDL_Rect *dst, SDL_Color c)
+{
+    push(NULL, NULL, dst, c);
+}
+
+void batch_texture_scaled(texture t, double x, double y, double scale)
+{
+    batch_copy(t.sdl_tex, &t.range, &(SDL_Rect){
+        x, y, iround(t.range.w * scale), iround(t.range.h * scale)
+    }, (SDL_Color){255, 255, 255, 255});
+}
+
+void batch_flush()
+{
+    static SDL_Vertex vert[BATCH_CAP * 4];
+    static int idx[BATCH_CAP * 6];
+    static bool idx_built = false;
+    int i;
+    if (n == 0) return;
+    if (!idx_built) {
+        /* Two triangles for each quad */
+        for (i = 0; i < BATCH_CAP; ++i) {
+            idx[i * 6 + 0] = i * 4 + 0;
+            idx[i * 6 + 1] = i * 4 + 1;
+            idx[i * 6 + 2] = i * 4 + 2;
+            idx[i * 6 + 3] = i * 4 + 2;
+            idx[i * 6 + 4] = i * 4 + 1;
+            idx[i * 6 + 5] = i * 4 + 3;
+        }
+        idx_built = true;
+    }
+
+    int w = 1, h = 1;
+    if (cur_tex != NULL) SDL_QueryTexture(cur_tex, NULL, NULL, &w, &h);
+    for (i = 0; i < n; ++i) {
+        struct quad *q = &quads[i];
+        float x0 = q->dst.x, x1 = q->dst.x + q->dst.w,
+            y0 = q->dst.y, y1 = q->dst.y + q->dst.h;
+        float u0 = (float)q->src.x / w, u1 = (float)(q->src.x + q->src.w) / w,
+            v0 = (float)q->src.y / h, v1 = (float)(q->src.y + q->src.h) / h;
+        SDL_Vertex *p = vert + i * 4;
+        p[0] = (SDL_Vertex){{x0, y0}, q->c, {u0, v0}};
+        p[1] = (SDL_Vertex){{x1, y0}, q->c, {u1, v0}};
+        p[2] = (SDL_Vertex){{x0, y1}, q->c, {u0, v1}};
+        p[3] = (SDL_Vertex){{x1, y1}, q->c, {u1, v1}};
+    }
+    SDL_RenderGeometry(g_renderer, cur_tex, vert, n * 4, idx, n * 6);
+    n = 0;
+}
@@ -0,0 +1,26 @@
+/* Batched drawing of textured and filled quads */
+
+#ifndef _BATCH_H
+#define _BATCH_H
+
+#include "resources.h"
+
+#include <SDL.h>
+
+/* Maximum number of quads submitted at once */
+#define BATCH_CAP   1024
+
+/* Quads are collected as long as they use the same texture,
+ * and submitted when it changes or when `batch_flush()` is called.
+ * Anything drawn without the batch should be preceded by a flush. */
+
+/* Draws the `src` part of `tex`, multiplied by colour `c` */
+void batch_copy(SDL_Texture *tex, const SDL_Rect *src, const SDL_Rect *dst,
+    SDL_Color c);
+/* Fills a rectangle with colour `c`, using the renderer's blend mode */
+void batch_fill(const SDL_Rect *dst, SDL_Color c);
+/* Same as `render_texture_scaled()` */
+void batch_texture_scaled(texture t, double x, double y, double scale);
+void batch_flush();
+
+#endif
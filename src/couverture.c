@@ -79,11 +79,11 @@ static inline double get_scale(double beat, double mul)
 
 static void couverture_draw(couverture *this)
 {
-    double t = (orion_tell(&g_orion, TRACKID_MAIN_BGM) - BGM_LOOP_A) / 44100.0;
+    double t = (orion_tell(&g_orion, TRACKID_MAIN_BGM) - BGM_LOOP_A) / g_orion.srate;
 
     if (t >= 0 && !this->canon_playing) {
         orion_play_loop(&g_orion, TRACKID_MAIN_BGM_CANON,
-            BGM_LOOP_A + (-16 * BGM_BEAT + t) * 44100,
+            BGM_LOOP_A + (-16 * BGM_BEAT + t) * g_orion.srate,
             BGM_LOOP_A, BGM_LOOP_B);
         orion_ramp(&g_orion, TRACKID_MAIN_BGM_CANON, 0, profile.bgm_vol * VOL_VALUE / 3);
         this->canon_playing = true;
@@ -203,12 +203,12 @@ static void couverture_key(couverture *this, SDL_KeyboardEvent *ev)
         case SDLK_UP:
         case SDLK_LEFT:
             move_menu_highlight(this, (this->menu_idx - 1 + N_MENU) % N_MENU);
-            orion_play_once(&g_orion, TRACKID_FX_SW1);
+            orion_voice_play(&g_orion, SFXID_SW1);
             break;
         case SDLK_DOWN:
         case SDLK_RIGHT:
             move_menu_highlight(this, (this->menu_idx + 1) % N_MENU);
-            orion_play_once(&g_orion, TRACKID_FX_SW1);
+            orion_voice_play(&g_orion, SFXID_SW1);
             break;
         case SDLK_RETURN:
         case SDLK_SPACE:
@@ -288,21 +288,22 @@ couverture *couverture_create()
     orion_play_loop(&g_orion, TRACKID_MAIN_BGM, 0, BGM_LOOP_A, BGM_LOOP_B);
     orion_ramp(&g_orion, TRACKID_MAIN_BGM, 0, profile.bgm_vol * VOL_VALUE * 2 / 3);
 
-    orion_apply_lowpass(&g_orion, TRACKID_MAIN_BGM, TRACKID_MAIN_BGM_LP, 1760);
+    orion_share(&g_orion, TRACKID_MAIN_BGM, TRACKID_MAIN_BGM_LP);
+    orion_filter_lowpass(&g_orion, TRACKID_MAIN_BGM_LP, 0, 1760);
     orion_play_loop(&g_orion, TRACKID_MAIN_BGM_LP, 0, BGM_LOOP_A, BGM_LOOP_B);
     orion_ramp(&g_orion, TRACKID_MAIN_BGM_LP, 0, 0);
 
-    orion_apply_lowpass(&g_orion, TRACKID_MAIN_BGM, TRACKID_MAIN_BGM_CANON, 22050);
+    orion_share(&g_orion, TRACKID_MAIN_BGM, TRACKID_MAIN_BGM_CANON);
 
-    orion_load_ogg(&g_orion, TRACKID_FX_SW1, "switch36.ogg");
-    orion_load_ogg(&g_orion, TRACKID_FX_SW2, "switch12.ogg");
-    orion_load_ogg(&g_orion, TRACKID_MENU_OPEN, "Menu1A.ogg");
-    orion_load_ogg(&g_orion, TRACKID_MENU_CLOSE, "Menu1B.ogg");
-    orion_load_ogg(&g_orion, TRACKID_MENU_CONFIRM, "Item2A.ogg");
+    orion_load_sample(&g_orion, SFXID_SW1, "switch36.ogg");
+    orion_load_sample(&g_orion, SFXID_SW2, "switch12.ogg");
+    orion_load_sample(&g_orion, SFXID_MENU_OPEN, "Menu1A.ogg");
+    orion_load_sample(&g_orion, SFXID_MENU_CLOSE, "Menu1B.ogg");
+    orion_load_sample(&g_orion, SFXID_MENU_CONFIRM, "Item2A.ogg");
 
     int i;
-    for (i = TRACKID_FX_FIRST; i <= TRACKID_FX_LAST; ++i)
-        orion_ramp(&g_orion, i, 0, profile.sfx_vol * VOL_VALUE);
+    for (i = SFXID_FIRST; i <= SFXID_LAST; ++i)
+        orion_sample_volume(&g_orion, i, profile.sfx_vol * VOL_VALUE);
 
     orion_overall_play(&g_orion);
 
@@ -31,7 +31,6 @@ static const char *TEXT =
     "Unless otherwise noted, all artwork assets in this project are compatible with the CC BY-SA 4.0 International licence.\n\n"
 
     "-   Tech fellows (in alphabetical order)   -\n"
-    "IIR1 (https://github.com/berndporr/iir1), MIT licence\n"
     "Ogg Vorbis (https://xiph.org/vorbis/), BSD licence\n"
     "PortAudio (http://portaudio.com/), MIT licence\n"
     "SDL, SDL_image, SDL_ttf (http://libsdl.org/), zlib licence\n"
@@ -70,27 +69,23 @@ static void credits_draw(credits_scene *this)
 {
     floue_draw(this->f);
 
-    /* Draw the main text */
-    int h = this->text->_base.tex.range.h + RANGE_H;
+    /* Draw the main text, scrolling through a window and
+     * reappearing after a gap */
+    int th = this->text->_base._base.dim.h;
+    int h = th + RANGE_H;
     int y = iround(this->p) % h;
     if (y < 0) y += h;
 
-    int ww = this->text->_base.tex.range.w,
-        hh = RANGE_H,
-        offy = 0;
-    if (y > this->text->_base.tex.range.h) {
-        hh = y + RANGE_H - h;
-        offy = RANGE_H - hh;
-        y = 0;
-    } else if (y + RANGE_H > this->text->_base.tex.range.h) {
-        hh = this->text->_base.tex.range.h - y;
+    SDL_RenderSetClipRect(g_renderer, &(SDL_Rect){
+        OFFS_X, OFFS_Y, this->text->_base._base.dim.w, RANGE_H
+    });
+    element_place((element *)this->text, OFFS_X, OFFS_Y - y);
+    element_draw((element *)this->text);
+    if (y + RANGE_H > h) {
+        element_place((element *)this->text, OFFS_X, OFFS_Y - y + h);
+        element_draw((element *)this->text);
     }
-
-    SDL_RenderCopy(
-        g_renderer, this->text->_base.tex.sdl_tex,
-        &(SDL_Rect){0, y, ww, hh},
-        &(SDL_Rect){OFFS_X, OFFS_Y + offy, ww, hh}
-    );
+    SDL_RenderSetClipRect(g_renderer, NULL);
 
     scene_draw_children((scene *)this);
 }
@@ -1,7 +1,6 @@
 #include "dialogue.h"
 #include "global.h"
 
-#include <ctype.h>
 #include <stdlib.h>
 #include <string.h>
 
@@ -9,29 +8,6 @@ static const double CTNR_FADE_DUR = 0.2;
 static const double AVAT_FADE_DUR = 0.1;
 static const double DELAY_PER_CHAR = 0.025;
 
-static void preprocess_text(char *str, TTF_Font *font, int wrap_w)
-{
-    int len = strlen(str);
-    int pos = 0;
-    int w;
-    while (pos < len) {
-        int lo = pos + 1, hi = len + 1, mid;
-        while (lo < hi - 1) {
-            mid = (lo + hi) >> 1;
-            char tmp = str[mid];
-            str[mid] = '\0';
-            if (TTF_SizeText(font, str + pos, &w, NULL) != 0) return;
-            str[mid] = tmp;
-            if (w > wrap_w) hi = mid; else lo = mid;
-        }
-        if (lo == len) break;
-        while (!isspace(str[lo]) && lo > pos) --lo;
-        if (lo == pos) return;
-        str[lo] = '\n';
-        pos = lo + 1;
-    }
-}
-
 static void dialogue_tick(dialogue_scene *this, double dt)
 {
     scene_tick(this->bg, dt);
@@ -47,18 +23,6 @@ static void dialogue_tick(dialogue_scene *this, double dt)
 
     dialogue_entry entry =
         bekter_at(this->script, this->script_idx, dialogue_entry);
-    if (this->entry_lasted >= AVAT_FADE_DUR) {
-        int textpos = (this->entry_lasted - AVAT_FADE_DUR * 2) / DELAY_PER_CHAR;
-        if (textpos > entry.text_len) textpos = entry.text_len;
-        if (textpos < 0) textpos = 0;
-        if (this->last_textpos != textpos) {
-            this->last_textpos = textpos;
-            char t = entry.text[textpos];
-            entry.text[textpos] = '\0';
-            label_set_text(this->text_disp, entry.text);
-            entry.text[textpos] = t;
-        }
-    }
 
     /* Update display for animations */
     if (this->last_tick < AVAT_FADE_DUR && this->entry_lasted >= AVAT_FADE_DUR) {
@@ -72,6 +36,19 @@ static void dialogue_tick(dialogue_scene *this, double dt)
             element_place_anchored((element *)this->name_disp,
                 WIN_W / 8, WIN_H * 60 / 72, 0.5, 0);
         }
+        /* The whole entry is laid out at once and revealed gradually */
+        label_set_visible(this->text_disp, 0);
+        label_set_text(this->text_disp, entry.text);
+        this->last_textpos = 0;
+    }
+    if (this->entry_lasted >= AVAT_FADE_DUR) {
+        int textpos = (this->entry_lasted - AVAT_FADE_DUR * 2) / DELAY_PER_CHAR;
+        if (textpos > entry.text_len) textpos = entry.text_len;
+        if (textpos < 0) textpos = 0;
+        if (this->last_textpos != textpos) {
+            this->last_textpos = textpos;
+            label_set_visible(this->text_disp, textpos);
+        }
     }
     this->last_tick = this->entry_lasted;
 }
@@ -206,7 +183,6 @@ dialogue_scene *dialogue_create(scene **bg, bekter(dialogue_entry) script)
             last_name = entry.name = strdup(entry.name);
         entry.text = strdup(entry.text);
         entry.text_len = strlen(entry.text);
-        preprocess_text(entry.text, l->font, l->wid);
         bekter_pushback(ret->script, entry);
     }
 
@@ -1,5 +1,6 @@
 #include "floue.h"
 #include "global.h"
+#include "batch.h"
 
 #include <math.h>
 #include <stdlib.h>
@@ -101,13 +102,12 @@ void floue_draw(floue *this)
     SDL_RenderFillRect(g_renderer, NULL);
     int i;
     for (i = 0; i < this->n; ++i) {
-        SDL_SetTextureColorMod(this->tex[i],
-            this->c[i].r, this->c[i].g, this->c[i].b);
-        SDL_RenderCopy(g_renderer, this->tex[i], NULL, &(SDL_Rect){
+        batch_copy(this->tex[i], NULL, &(SDL_Rect){
             this->x[i] - this->sz[i] * this->scale[i] / 2,
             this->y[i] - this->sz[i] * this->scale[i] / 2,
             this->sz[i] * this->scale[i],
             this->sz[i] * this->scale[i]
-        });
+        }, (SDL_Color){this->c[i].r, this->c[i].g, this->c[i].b, 255});
     }
+    batch_flush();
 }
@@ -104,11 +104,12 @@ struct stage_rec *stage_read(const char *path)
     /* List of audio sources */
     fscanf(f, "%d", &m);
     fgetc(f);
-    this->aud_ct = m;
+    this->aud_ct = (m < MAX_AUD_SOURCES ? m : MAX_AUD_SOURCES);
     for (i = 0; i < m; ++i) {
         int tid, r, c;
         fscanf(f, "%d,%d,%d", &tid, &r, &c);
-        this->aud[i] = (struct _stage_audsrc){(char)tid, r, c};
+        if (i < MAX_AUD_SOURCES)
+            this->aud[i] = (struct _stage_audsrc){(char)tid, r, c};
     }
 
     /* List of hints */
@@ -250,8 +251,8 @@ struct chap_rec *chap_read(const char *path)
     fscanf(f, "%lf,%d", &this->offs, &this->loop);
 
     fscanf(f, "%d", &m);
-    if (m > MAX_CHAP_TRACKS) { free(this); fclose(f); return NULL; }
     this->n_tracks = m;
+    this->tracks = malloc(sizeof(struct _chap_track) * m);
     for (i = 0; i < m; ++i) {
         int src_id;
         char str[64];
@@ -294,6 +295,13 @@ struct chap_rec *chap_read(const char *path)
         this->stages[i] = stage_read(s);
         world_r = (this->stages[i]->world_r += world_r);
         world_c = (this->stages[i]->world_c += world_c);
+        /* Audio sources may only refer to the chapter's tracks */
+        struct stage_rec *st = this->stages[i];
+        int j, k = 0;
+        for (j = 0; j < st->aud_ct; ++j)
+            if (st->aud[j].tid >= 0 && st->aud[j].tid < this->n_tracks)
+                st->aud[k++] = st->aud[j];
+        st->aud_ct = k;
 #ifndef NDEBUG
         printf("Stage #%d: %d %d\n", i + 1, world_r, world_c);
 #endif
@@ -309,6 +317,7 @@ void chap_drop(struct chap_rec *this)
     int i;
     for (i = 0; i < this->n_ss; ++i) free(this->ss[i].image);
     for (i = 0; i < this->n_tracks; ++i) free(this->tracks[i].str);
+    free(this->tracks);
     for (i = 0; i < this->n_stages; ++i) stage_drop(this->stages[i]);
     free(this);
 }
@@ -118,8 +118,7 @@ struct chap_rec {
     unsigned int hop_mask;
 
     /* Tracks */
-#define MAX_CHAP_TRACKS 6
-    struct _chap_track tracks[MAX_CHAP_TRACKS];
+    struct _chap_track *tracks;
     int n_tracks;
 
     /* Sidescrollers */
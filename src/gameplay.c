@@ -2,6 +2,7 @@
 
 #include "global.h"
 #include "bekter.h"
+#include "batch.h"
 #include "game_data.h"
 #include "unary_transition.h"
 #include "pause.h"
@@ -22,6 +23,9 @@ static const double WIN_W_UNITS = (double)WIN_W / UNIT_PX;
 static const double WIN_H_UNITS = (double)WIN_H / UNIT_PX;
 #define SPR_PX 16.0
 static const double SPR_SCALE = UNIT_PX / SPR_PX;
+/* Size of the world layers, drawn at sprites' native resolution */
+#define WORLD_W ((int)(WIN_W * SPR_PX / UNIT_PX))
+#define WORLD_H ((int)(WIN_H * SPR_PX / UNIT_PX))
 
 static const double VIVACE_MUL = 1.2;
 static const double ANDANTE_MUL = 0.8;
@@ -63,6 +67,8 @@ static const double DIALOGUE_ZOOM_DUR = 0.9;
 static const double DIALOGUE_ZOOM_SCALE = 1.5;
 static const double DIALOGUE_BGM_FADE = 0.3;
 static const double CHAPFIN_BGM_FADE = 0.6;
+/* Seconds of stretched music into the loop produced before play starts */
+static const double BGM_STRETCH_LEAD = 4;
 static const int HINT_FONTSZ = 36;
 static const int HINT_PADDING = 12;
 static const int CLOCK_CHAP_FONTSZ = 44;
@@ -100,7 +106,7 @@ static const SDL_Rect MT_UPBEAT[2] = {
 
 static inline double get_audio_position(gameplay_scene *this)
 {
-    double sec = (double)orion_tell(&g_orion, TRACKID_STAGE_BGM) / 44100;
+    double sec = orion_tell_precise(&g_orion, this->bgm_tids[0]) / g_orion.srate;
     return (sec + AUD_OFFSET + profile.av_offset * 0.001) / BEAT;
 }
 
@@ -228,9 +234,12 @@ static inline void switch_stage_ctx(gameplay_scene *this)
     if (++this->cur_stage_idx == this->chap->n_stages) {
         this->disp_state = DISP_CHAPFIN;
         this->total_time = this->simulator->cur_time;
+        this->prev_tiles = this->tiles;
     } else {
         this->rec = this->chap->stages[this->cur_stage_idx];
         this->simulator = stage_create_sim(this->rec);
+        this->prev_tiles = this->tiles;
+        this->tiles = tilemap_create(this->simulator, this->rec->grid_tex);
         this->stage_start_time =
         this->simulator->cur_time = (this->prev_sim == NULL ?
             get_audio_position(this) / this->chap->beat_mul :
@@ -288,6 +297,15 @@ static inline void stop_prot(gameplay_scene *this)
     this->simulator->prot.tag = 0;
 }
 
+static inline void drop_prev_sim(gameplay_scene *this)
+{
+    sim_drop(this->prev_sim);
+    this->prev_sim = NULL;
+    if (this->prev_tiles != NULL && this->prev_tiles != this->tiles)
+        tilemap_drop(this->prev_tiles);
+    this->prev_tiles = NULL;
+}
+
 static void retry_reinit(gameplay_scene *this)
 {
     stop_prot(this);
@@ -307,11 +325,8 @@ static void gameplay_scene_tick(gameplay_scene *this, double dt)
 {
     if (this->paused) return;
     if (this->disp_state == DISP_LEADIN) {
-        if ((this->disp_time -= dt) <= 0) {
+        if ((this->disp_time -= dt) <= 0)
             this->disp_state = DISP_NORMAL;
-            SDL_DestroyTexture(this->leadin_tex);
-            this->leadin_tex = NULL;
-        }
     } else if (this->disp_state == DISP_FAILURE) {
         if ((this->disp_time -= dt) <= 0) {
             /* Run a transition to reset the stage */
@@ -366,12 +381,9 @@ static void gameplay_scene_tick(gameplay_scene *this, double dt)
             /* The bug is triggered if the protagonist enters a stage
              * with instant failure, and this stage is completed
              * in one run with no retries afterwards */
-            if (this->prev_sim != NULL) {
-                sim_drop(this->prev_sim);
-                this->prev_sim = NULL;
-            }
+            if (this->prev_sim != NULL) drop_prev_sim(this);
             this->simulator->prot.tag = 0;
-            orion_play_once(&g_orion, TRACKID_FX_FAIL);
+            orion_voice_play(&g_orion, SFXID_FAIL);
             break;
         case PROT_TAG_NXSTAGE:
             if (this->disp_state != DISP_NORMAL) break;
@@ -387,23 +399,22 @@ static void gameplay_scene_tick(gameplay_scene *this, double dt)
                 this->simulator->prot.y -= delta_y;
                 this->cam_x -= delta_x;
                 this->cam_y -= delta_y;
-                orion_play_once(&g_orion, TRACKID_FX_NXSTAGE);
+                orion_voice_play(&g_orion, SFXID_NXSTAGE);
             } else if (this->simulator->cur_time - this->simulator->prot.t
                 >= STAGE_TRANSITION_DUR)
             {
-                sim_drop(this->prev_sim);
-                this->prev_sim = NULL;
+                drop_prev_sim(this);
                 this->simulator->prot.tag = 0;
             }
             break;
         case PROT_TAG_REFILL:
             this->refill_time = REFILL_PERSISTENCE;
             this->simulator->prot.tag = 0;
-            orion_play_once(&g_orion, TRACKID_FX_PICKUP);
+            orion_voice_play(&g_orion, SFXID_PICKUP);
             break;
         case PROT_TAG_SPRING:
             this->simulator->prot.tag = 0;
-            orion_play_once(&g_orion, TRACKID_FX_SPRING);
+            orion_voice_play(&g_orion, SFXID_SPRING);
             break;
     }
 
@@ -533,26 +544,18 @@ static inline int align_pixel(double x)
     return iround(x / SPR_SCALE) * SPR_SCALE;
 }
 
+/* Objects are drawn onto the world layers, in native pixels;
+ * positions are aligned to them on the screen, so this is lossless */
 static inline void render_object(gameplay_scene *this,
-    bool rounds, int cxi, int cyi, int sx, int sy, sobj *o)
+    bool rounds, int cxi, int cyi, sobj *o)
 {
     int x = align_pixel(((rounds ? (int)o->x : o->x) + o->tx) * UNIT_PX) - cxi,
         y = align_pixel(((rounds ? (int)o->y : o->y) + o->ty) * UNIT_PX) - cyi;
-    if (this->scale == 1) {
-        render_texture_scaled(get_texture(this, o), x, y, SPR_SCALE);
-    } else {
-        x = round(sx + (x - sx) * this->scale);
-        y = round(sy + (y - sy) * this->scale);
-        render_texture_scaled(get_texture(this, o),
-            x, y, SPR_SCALE * this->scale);
-        render_texture_scaled(get_texture(this, o),
-            x + 1, y + 1, SPR_SCALE * this->scale);
-    }
+    batch_texture_scaled(get_texture(this, o), x / SPR_SCALE, y / SPR_SCALE, 1);
 }
 
 static inline void render_objects(gameplay_scene *this,
-    bool is_prev, bool is_after, int offsx, int offsy,
-    int scale_x, int scale_y)
+    bool is_prev, bool is_after, int offsx, int offsy)
 {
     sim *sim = (is_prev ? this->prev_sim : this->simulator);
     double cx = (is_prev ? this->cam_x + offsx : this->cam_x);
@@ -564,16 +567,36 @@ static inline void render_objects(gameplay_scene *this,
     int r, c;
     int cxi = align_pixel(this->cam_x * UNIT_PX) + (is_prev ? offsx * UNIT_PX : 0),
         cyi = align_pixel(this->cam_y * UNIT_PX) + (is_prev ? offsy * UNIT_PX : 0);
+    /* Cells that never change are baked, draw the rest one by one */
+    tilemap_draw(is_prev ? this->prev_tiles : this->tiles, is_after,
+        WORLD_W, WORLD_H, -cxi / SPR_SCALE, -cyi / SPR_SCALE, SPR_PX);
     for (r = rmin; r < rmax; ++r)
         for (c = cmin; c < cmax; ++c) {
             sobj *o = &sim_grid(sim, r, c);
-            if (o->tag != 0 && ((o->tag < OBJID_DRAW_AFTER) ^ is_after))
-                render_object(this, true, cxi, cyi, scale_x, scale_y, o);
+            if (o->tag != 0 && !tilemap_baked(o) &&
+                ((o->tag < OBJID_DRAW_AFTER) ^ is_after))
+                render_object(this, true, cxi, cyi, o);
         }
     for (r = 0; r < sim->anim_sz; ++r) {
         sobj *o = sim->anim[r];
         if ((o->tag < OBJID_DRAW_AFTER) ^ is_after)
-            render_object(this, false, cxi, cyi, scale_x, scale_y, o);
+            render_object(this, false, cxi, cyi, o);
+    }
+    batch_flush();
+}
+
+/* Composites a world layer, zoomed from (sx, sy) on the screen */
+static inline void draw_world(gameplay_scene *this, int layer, double sx, double sy)
+{
+    if (this->scale == 1) {
+        SDL_RenderCopy(g_renderer, this->world_tex[layer], NULL, NULL);
+    } else {
+        int x0 = round(sx - sx * this->scale),
+            y0 = round(sy - sy * this->scale),
+            x1 = round(sx + (WIN_W - sx) * this->scale),
+            y1 = round(sy + (WIN_H - sy) * this->scale);
+        SDL_RenderCopy(g_renderer, this->world_tex[layer], NULL,
+            &(SDL_Rect){x0, y0, x1 - x0, y1 - y0});
     }
 }
 
@@ -581,11 +604,6 @@ void gameplay_run_leadin(gameplay_scene *this)
 {
     this->disp_state = DISP_LEADIN;
     this->disp_time = LEADIN_DUR + LEADIN_INIT;
-
-    this->leadin_tex = SDL_CreateTexture(
-        g_renderer, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_STREAMING,
-        WIN_W, WIN_H);
-    SDL_SetTextureBlendMode(this->leadin_tex, SDL_BLENDMODE_BLEND);
 }
 
 static inline bool get_pos_in_bar(gameplay_scene *this, double ant, int mul,
@@ -633,68 +651,98 @@ static inline void draw_overlay(gameplay_scene *this)
         SDL_RenderDrawRects(g_renderer, MT_UPBEAT, 2);
 }
 
-static inline void flashlight_texture(SDL_Texture *tex,
-    int w, int h, double x, double y, double rsqr, double rosqr)
+#define FLASHLIGHT_SEGS     128 /* Sides of the polygons approximating circles */
+#define FLASHLIGHT_RINGS    8   /* Rings making up the gradient */
+
+/* Darkens everything outside a circle centred at (x, y); the opacity rises
+ * from 0 at radius `r` to 1 at `ro`, linearly in squared distance */
+static inline void draw_flashlight(double x, double y, double r, double ro)
 {
+    static SDL_Vertex vert[(FLASHLIGHT_RINGS + 2) * FLASHLIGHT_SEGS];
+    static int idx[(FLASHLIGHT_RINGS + 1) * FLASHLIGHT_SEGS * 6];
+    static float cosine[FLASHLIGHT_SEGS], sine[FLASHLIGHT_SEGS];
+    static bool initialized = false;
     int i, j;
-    void *pixdata;
-    int pitch;
-    SDL_LockTexture(tex, NULL, &pixdata, &pitch);
-    for (j = 0; j < h; ++j)
-        for (i = 0; i < w; ++i) {
-            double r = sqr(i - x) + sqr(j - y);
-            if (r <= rsqr) {
-                *((int *)(pixdata + j * pitch) + i) = 0;
-            } else if (r <= rosqr) {
-                int a = iround(255 * (r - rsqr) / (rosqr - rsqr));
-                *((int *)(pixdata + j * pitch) + i) = a;
-            } else {
-                *((int *)(pixdata + j * pitch) + i) = 255;
-            }
+    if (!initialized) {
+        for (i = 0; i < FLASHLIGHT_SEGS; ++i) {
+            cosine[i] = cos(M_PI * 2 * i / FLASHLIGHT_SEGS);
+            sine[i] = sin(M_PI * 2 * i / FLASHLIGHT_SEGS);
         }
-    SDL_UnlockTexture(tex);
+        /* Each ring is joined to the next one by a strip of quads */
+        int *p = idx;
+        for (j = 0; j <= FLASHLIGHT_RINGS; ++j)
+            for (i = 0; i < FLASHLIGHT_SEGS; ++i) {
+                int a = j * FLASHLIGHT_SEGS + i,
+                    b = j * FLASHLIGHT_SEGS + (i + 1) % FLASHLIGHT_SEGS;
+                *(p++) = a; *(p++) = b; *(p++) = a + FLASHLIGHT_SEGS;
+                *(p++) = a + FLASHLIGHT_SEGS; *(p++) = b; *(p++) = b + FLASHLIGHT_SEGS;
+            }
+        initialized = true;
+    }
+
+    for (j = 0; j <= FLASHLIGHT_RINGS + 1; ++j) {
+        /* The outermost ring covers the window wherever the centre is */
+        double rr = (j <= FLASHLIGHT_RINGS ?
+            r + (ro - r) * j / FLASHLIGHT_RINGS : ro + 2 * (WIN_W + WIN_H));
+        int a = (j >= FLASHLIGHT_RINGS || ro <= r ? 255 :
+            iround(255 * (sqr(rr) - sqr(r)) / (sqr(ro) - sqr(r))));
+        for (i = 0; i < FLASHLIGHT_SEGS; ++i)
+            vert[j * FLASHLIGHT_SEGS + i] = (SDL_Vertex){
+                {x + rr * cosine[i], y + rr * sine[i]}, {0, 0, 0, a}, {0, 0}
+            };
+    }
+    SDL_SetRenderDrawBlendMode(g_renderer, SDL_BLENDMODE_BLEND);
+    SDL_RenderGeometry(g_renderer, NULL, vert, sizeof vert / sizeof vert[0],
+        idx, sizeof idx / sizeof idx[0]);
+}
+
+/* Starts or stops all stems at the same sample */
+static inline void schedule_bgm(gameplay_scene *this, enum orion_sched_action action)
+{
+    orion_schedule(&g_orion, this->bgm_tids, this->chap->n_tracks,
+        orion_overall_tell(&g_orion), action);
 }
 
 static inline void pause_sound(gameplay_scene *this)
 {
     this->paused = true;
-    int i;
-    for (i = 0; i < this->chap->n_tracks; ++i)
-        orion_pause(&g_orion, TRACKID_STAGE_BGM + i);
+    this->bgm_playing = false;
+    schedule_bgm(this, ORION_SCHED_PAUSE);
 }
 
 static inline void update_sound(gameplay_scene *this)
 {
     int i;
-    if ((scene *)this == g_stage) {
-        this->paused = false;
-        for (i = 0; i < this->chap->n_tracks; ++i)
-            orion_resume(&g_orion, TRACKID_STAGE_BGM + i);
+    /* Stems are mixed by orion according to the distances
+     * between the player and the audio sources of the stage */
+    if (this->emit_rec != this->rec) {
+        this->emit_rec = this->rec;
+        struct orion_emitter e[MAX_AUD_SOURCES];
+        for (i = 0; i < this->rec->aud_ct; ++i)
+            e[i] = (struct orion_emitter){
+                this->bgm_tids[(int)this->rec->aud[i].tid],
+                this->rec->aud[i].c, this->rec->aud[i].r
+            };
+        orion_spatial_emitters(&g_orion, e, this->rec->aud_ct);
     }
-    if (this->mods & MOD_A_CAPELLA) {
-        for (i = 0; i < this->chap->n_tracks; ++i)
-            orion_ramp(&g_orion, TRACKID_STAGE_BGM + i, 0, 0);
-    } else {
-        float val[MAX_CHAP_TRACKS] = { 0 }, sum = 0;
-        for (i = 0; i < this->rec->aud_ct; ++i) {
-            float d = sqrtf(
-                sqr(this->simulator->prot.y + this->rec->world_r - this->rec->aud[i].r) +
-                sqr(this->simulator->prot.x + this->rec->world_c - this->rec->aud[i].c)
-            );
-            d = 1 / d;
-            val[this->rec->aud[i].tid] += d;
-            sum += d;
-        }
+    float gain = 0;
+    if (!(this->mods & MOD_A_CAPELLA)) {
         bool is_dialogue =
             this->disp_state == DISP_DIALOGUE_IN || this->disp_state == DISP_DIALOGUE_OUT;
-        for (i = 0; i < this->chap->n_tracks; ++i) {
-#ifndef NDEBUG
-            printf("%.4lf%c", val[i] / sum, i == this->chap->n_tracks - 1 ? '\n' : ' ');
-#endif
-            orion_ramp(&g_orion, TRACKID_STAGE_BGM + i,
-                0.03, val[i] / sum * profile.bgm_vol * VOL_VALUE *
-                    (is_dialogue ? DIALOGUE_BGM_FADE :
-                     this->disp_state == DISP_CHAPFIN ? CHAPFIN_BGM_FADE : 1));
+        gain = profile.bgm_vol * VOL_VALUE *
+            (is_dialogue ? DIALOGUE_BGM_FADE :
+             this->disp_state == DISP_CHAPFIN ? CHAPFIN_BGM_FADE : 1);
+    }
+    orion_spatial_listener(&g_orion,
+        this->simulator->prot.x + this->rec->world_c,
+        this->simulator->prot.y + this->rec->world_r, gain);
+    /* Start the stems only after their emitters are known,
+     * otherwise they would fade in from silence */
+    if ((scene *)this == g_stage) {
+        this->paused = false;
+        if (!this->bgm_playing) {
+            this->bgm_playing = true;
+            schedule_bgm(this, ORION_SCHED_RESUME);
         }
     }
 }
@@ -740,8 +788,7 @@ static inline void draw_hint(gameplay_scene *this, int i, double dmul, int cxi,
         }
     }
     SDL_RenderFillRect(g_renderer, &(SDL_Rect){x, y, w, h});
-    SDL_SetTextureAlphaMod(
-        this->l_hints[i]->_base.tex.sdl_tex, round(255 * dmul));
+    this->l_hints[i]->_base.alpha = round(255 * dmul);
     element_draw((element *)this->l_hints[i]);
     /* Display images */
     if (this->rec->hints[i].img != NULL) {
@@ -752,17 +799,18 @@ static inline void draw_hint(gameplay_scene *this, int i, double dmul, int cxi,
         int j;
         for (j = 0; j < sig; ++j) {
             double prog = (started && beats_i == j ? 1 - beats_d : 0);
+            sprite *s = this->s_hints[i][j];
+            SDL_Color c = {255, 255, 255};
             if (this->rec->hints[i].mask & (1 << beats_i)) {
-                this->s_hints[i][j]->alpha = iround((96 + 159 * prog) * dmul);
-                SDL_SetTextureColorMod(this->s_hints[i][j]->tex.sdl_tex,
-                    255, 255, iround((1 - prog) * 255));
+                c.a = iround((96 + 159 * prog) * dmul);
+                c.b = iround((1 - prog) * 255);
             } else {
-                this->s_hints[i][j]->alpha = iround(96 * (1 - prog) * dmul);
+                c.a = iround(96 * (1 - prog) * dmul);
             }
-            element_draw((element *)this->s_hints[i][j]);
-            SDL_SetTextureAlphaMod(this->s_hints[i][j]->tex.sdl_tex, 255);
-            SDL_SetTextureColorMod(this->s_hints[i][j]->tex.sdl_tex, 255, 255, 255);
+            /* All slices share one texture */
+            batch_copy(s->tex.sdl_tex, &s->tex.range, &s->_base.dim, c);
         }
+        batch_flush();
     }
 }
 
@@ -827,15 +875,27 @@ static void gameplay_scene_draw(gameplay_scene *this)
     prot_w = prot_tex.range.w * SPR_SCALE;
     prot_h = prot_tex.range.h * SPR_SCALE;
 
+    /* Render both layers of the world, below and above the protagonist */
+    SDL_Texture *last_target = SDL_GetRenderTarget(g_renderer);
+    for (i = 0; i < 2; ++i) {
+        SDL_SetRenderTarget(g_renderer, this->world_tex[i]);
+        SDL_SetRenderDrawColor(g_renderer, 0, 0, 0, 0);
+        SDL_RenderClear(g_renderer);
+    }
+    SDL_SetRenderTarget(g_renderer, this->world_tex[0]);
     /* Draw the previous stage during transition */
     if (this->prev_sim != NULL) {
         int delta_x = this->simulator->worldc - this->prev_sim->worldc;
         int delta_y = this->simulator->worldr - this->prev_sim->worldr;
-        render_objects(this, true, false, delta_x, delta_y, prot_disp_x, prot_disp_y);
-        render_objects(this, true, true, delta_x, delta_y, prot_disp_x, prot_disp_y);
+        render_objects(this, true, false, delta_x, delta_y);
+        render_objects(this, true, true, delta_x, delta_y);
     }
+    render_objects(this, false, false, 0, 0);
+    SDL_SetRenderTarget(g_renderer, this->world_tex[1]);
+    render_objects(this, false, true, 0, 0);
+    SDL_SetRenderTarget(g_renderer, last_target);
 
-    render_objects(this, false, false, 0, 0, prot_disp_x, prot_disp_y);
+    draw_world(this, 0, prot_disp_x, prot_disp_y);
 
     if (this->disp_state == DISP_FAILURE) {
         int f_idx = clamp(FAILURE_NF - (int)(this->disp_time / FAILURE_SPF) - 1,
@@ -844,7 +904,7 @@ static void gameplay_scene_draw(gameplay_scene *this)
         /* The failure animation should be displayed above everything else;
          * No dialogue or stage transition
          * should be running during failure animation */
-        render_objects(this, false, true, 0, 0, 0, 0);
+        draw_world(this, 1, prot_disp_x, prot_disp_y);
     } else if (fabs(this->simulator->prot.vy) > 1e-6) {
         if (this->since_hop < HOP_SPF) {
             prot_tex = this->rec->prot_hop_tex[HOP_FRAME_ANT1];
@@ -875,7 +935,7 @@ static void gameplay_scene_draw(gameplay_scene *this)
     }, 0, NULL, (this->facing == HOR_STATE_LEFT ? SDL_FLIP_HORIZONTAL : 0));
 
     if (this->disp_state != DISP_FAILURE)
-        render_objects(this, false, true, 0, 0, prot_disp_x, prot_disp_y);
+        draw_world(this, 1, prot_disp_x, prot_disp_y);
 
     /* Display foreground hints */
     for (i = 0; i < this->rec->hint_ct; ++i) {
@@ -902,24 +962,11 @@ static void gameplay_scene_draw(gameplay_scene *this)
             radius = radius_o - UNIT_PX * 0.5;
             if (radius < 0) radius = 0;
         }
-        flashlight_texture(this->leadin_tex,
-            WIN_W, WIN_H, prot_disp_x, prot_disp_y, sqr(radius), sqr(radius_o));
-        SDL_RenderCopy(g_renderer, this->leadin_tex, NULL, NULL);
+        draw_flashlight(prot_disp_x, prot_disp_y, radius, radius_o);
     } else if (this->mods & MOD_STRETTO) {
         /* Flashlight! */
-        if (this->leadin_tex == NULL) {
-            this->leadin_tex = SDL_CreateTexture(
-                g_renderer, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_STREAMING,
-                WIN_W * 2, WIN_H * 2);
-            SDL_SetTextureBlendMode(this->leadin_tex, SDL_BLENDMODE_BLEND);
-            flashlight_texture(this->leadin_tex,
-                WIN_W * 2, WIN_H * 2, WIN_W, WIN_H,
-                sqr(UNIT_PX * STRETTO_RANGE), sqr(UNIT_PX * (STRETTO_RANGE + 0.5)));
-        }
-        SDL_RenderCopy(g_renderer, this->leadin_tex, &(SDL_Rect) {
-            iround(WIN_W - prot_disp_x), iround(WIN_H - prot_disp_y),
-            WIN_W, WIN_H
-        }, NULL);
+        draw_flashlight(prot_disp_x, prot_disp_y,
+            UNIT_PX * STRETTO_RANGE, UNIT_PX * (STRETTO_RANGE + 0.5));
     }
 
     /* Draw particles */
@@ -971,18 +1018,18 @@ static void gameplay_scene_draw(gameplay_scene *this)
                 int dx = (1 - ease_elastic_out(r, 3)) * (WIN_W / 4);
                 this->clock_stg->_base._base.dim.x -= dx;
                 this->clock_stg_dec->_base._base.dim.x -= dx;
-                SDL_SetTextureColorMod(this->clock_stg->_base.tex.sdl_tex, 160, 160, 160);
-                SDL_SetTextureColorMod(this->clock_stg_dec->_base.tex.sdl_tex, 160, 160, 160);
+                label_colour_mod(this->clock_stg, 160, 160, 160);
+                label_colour_mod(this->clock_stg_dec, 160, 160, 160);
             } else {
                 int lr = lerp(r, 255, 160),
                     lg = lerp(r, 216, 160),
                     lb = lerp(r, 128, 160);
-                SDL_SetTextureColorMod(this->clock_stg->_base.tex.sdl_tex, lr, lg, lb);
-                SDL_SetTextureColorMod(this->clock_stg_dec->_base.tex.sdl_tex, lr, lg, lb);
+                label_colour_mod(this->clock_stg, lr, lg, lb);
+                label_colour_mod(this->clock_stg_dec, lr, lg, lb);
             }
         } else {
-            SDL_SetTextureColorMod(this->clock_stg->_base.tex.sdl_tex, 160, 160, 160);
-            SDL_SetTextureColorMod(this->clock_stg_dec->_base.tex.sdl_tex, 160, 160, 160);
+            label_colour_mod(this->clock_stg, 160, 160, 160);
+            label_colour_mod(this->clock_stg_dec, 160, 160, 160);
         }
         element_draw((element *)this->clock_stg);
         element_draw((element *)this->clock_stg_dec);
@@ -991,13 +1038,18 @@ static void gameplay_scene_draw(gameplay_scene *this)
 
 static void gameplay_scene_drop(gameplay_scene *this)
 {
-    if (this->leadin_tex != NULL) SDL_DestroyTexture(this->leadin_tex);
     if (this->prev_sim != NULL) sim_drop(this->prev_sim);
     if (this->simulator != NULL && this->simulator != this->prev_sim)
         sim_drop(this->simulator);
+    if (this->prev_tiles != NULL) tilemap_drop(this->prev_tiles);
+    if (this->tiles != NULL && this->tiles != this->prev_tiles)
+        tilemap_drop(this->tiles);
     int i, j;
+    for (i = 0; i < 2; ++i)
+        if (this->world_tex[i] != NULL) SDL_DestroyTexture(this->world_tex[i]);
     for (i = 0; i < this->chap->n_tracks; ++i)
-        orion_ramp(&g_orion, TRACKID_STAGE_BGM + i, 0.3, 0);
+        orion_track_drop(&g_orion, this->bgm_tids[i], 0.3);
+    free(this->bgm_tids);
     for (i = 0; i < MAX_HINTS; ++i) {
         element_drop(this->l_hints[i]);
         for (j = 0; j < MAX_SIG; ++j)
@@ -1095,10 +1147,10 @@ static void gameplay_scene_key_handler(gameplay_scene *this, SDL_KeyboardEvent *
         case SDLK_z:
             if (!ev->repeat && ev->state == SDL_PRESSED) {
                 if (try_hop(this)) {
-                    orion_play_once(&g_orion, TRACKID_FX_HOP);
+                    orion_voice_play(&g_orion, SFXID_HOP);
                     this->since_hop = 0;
                 } else {
-                    orion_play_once(&g_orion, TRACKID_FX_UNAVAIL);
+                    orion_voice_play(&g_orion, SFXID_UNAVAIL);
                 }
             }
             break;
@@ -1106,10 +1158,10 @@ static void gameplay_scene_key_handler(gameplay_scene *this, SDL_KeyboardEvent *
         case SDLK_x:
             if (!ev->repeat && ev->state == SDL_PRESSED) {
                 if (try_dash(this, false)) {
-                    orion_play_once(&g_orion, TRACKID_FX_DASH);
+                    orion_voice_play(&g_orion, SFXID_DASH);
                     this->since_hop = 0;
                 } else {
-                    orion_play_once(&g_orion, TRACKID_FX_UNAVAIL);
+                    orion_voice_play(&g_orion, SFXID_UNAVAIL);
                 }
             }
             break;
@@ -1176,6 +1228,15 @@ void gameplay_init_textures(gameplay_scene *this)
         this->clock_stg_dec = l;
     }
 
+    /* Upscaled with sharp pixels */
+    SDL_SetHint(SDL_HINT_RENDER_SCALE_QUALITY, "0");
+    for (i = 0; i < 2; ++i) {
+        this->world_tex[i] = SDL_CreateTexture(g_renderer, SDL_PIXELFORMAT_RGBA8888,
+            SDL_TEXTUREACCESS_TARGET, WORLD_W, WORLD_H);
+        set_premultiplied(this->world_tex[i]);
+    }
+    SDL_SetHint(SDL_HINT_RENDER_SCALE_QUALITY, "1");
+
     switch_stage_ctx(this);
     this->stage_start_time = 0;
 
@@ -1194,6 +1255,9 @@ gameplay_scene *gameplay_scene_create(scene *bg, struct chap_rec *chap, int idx,
     ret->bg = bg;
 
     ret->rem_time = 0;
+    ret->paused = false;
+    ret->bgm_playing = false;
+    ret->emit_rec = NULL;
     ret->facing = HOR_STATE_RIGHT;
     ret->since_hop = -1e10;
 
@@ -1206,44 +1270,58 @@ gameplay_scene *gameplay_scene_create(scene *bg, struct chap_rec *chap, int idx,
     /* Sound should be loaded before the stage, as
      * the play position will be used to initialize the simulator */
     int i;
+    ret->bgm_tids = malloc(sizeof(int) * chap->n_tracks);
+    for (i = 0; i < chap->n_tracks; ++i)
+        ret->bgm_tids[i] = orion_track_create(&g_orion);
     for (i = 0; i < chap->n_tracks; ++i) {
         if (chap->tracks[i].src_id == -1) {
-            orion_load_ogg(&g_orion, TRACKID_STAGE_BGM + i, chap->tracks[i].str);
+            orion_load_ogg(&g_orion, ret->bgm_tids[i], chap->tracks[i].str);
+            /* Only the intro and the beginning of the loop are stretched
+             * here; the rest is produced in the background during play */
             if (ret->mul != 1)
-                orion_apply_stretch(&g_orion,
-                    TRACKID_STAGE_BGM + i, TRACKID_STAGE_BGM + i,
-                    (ret->mul - 1) * 100);
+                orion_apply_stretch_lazy(&g_orion,
+                    ret->bgm_tids[i], ret->bgm_tids[i],
+                    (ret->mul - 1) * 100,
+                    (int)((chap->offs / ret->mul + BGM_STRETCH_LEAD) * g_orion.srate));
+#ifdef GRADATIM_LOW_MEMORY
+            orion_compress(&g_orion, ret->bgm_tids[i]);
+#endif
         } else if (strcmp(chap->tracks[i].str, "lowpass") == 0) {
-            orion_apply_lowpass(&g_orion,
-                TRACKID_STAGE_BGM + chap->tracks[i].src_id,
-                TRACKID_STAGE_BGM + i,
-                chap->tracks[i].arg);
+            orion_share(&g_orion,
+                ret->bgm_tids[(int)chap->tracks[i].src_id],
+                ret->bgm_tids[i]);
+            orion_filter_lowpass(&g_orion,
+                ret->bgm_tids[i], 0, chap->tracks[i].arg);
         }
     }
-    /* Play at the same time in order to avoid incorrect syncronization */
+    /* Leave all stems stopped at the beginning;
+     * they will be started together by `update_sound()` */
     for (i = 0; i < chap->n_tracks; ++i) {
-        orion_play_loop(&g_orion, TRACKID_STAGE_BGM + i,
+        orion_play_loop(&g_orion, ret->bgm_tids[i],
             0,
-            (int)(chap->offs / ret->mul * 44100),
-            (int)((chap->offs + chap->beat * chap->loop) / ret->mul * 44100));
-        orion_ramp(&g_orion, TRACKID_STAGE_BGM + i, 0, 0);
-        orion_pause(&g_orion, TRACKID_STAGE_BGM + i);
+            (int)(chap->offs / ret->mul * g_orion.srate),
+            (int)((chap->offs + chap->beat * chap->loop) / ret->mul * g_orion.srate));
+        orion_ramp(&g_orion, ret->bgm_tids[i], 0, 1);
+        orion_pause(&g_orion, ret->bgm_tids[i]);
+        /* Stems without a source in the current stage stay silent */
+        orion_spatial_track(&g_orion, ret->bgm_tids[i], 1);
+        orion_seek(&g_orion, ret->bgm_tids[i], 0);
     }
 
-    orion_load_ogg(&g_orion, TRACKID_FX_PICKUP, "pickup.ogg");
-    orion_load_ogg(&g_orion, TRACKID_FX_HOP, "hop.ogg");
-    orion_load_ogg(&g_orion, TRACKID_FX_DASH, "dash.ogg");
-    orion_load_ogg(&g_orion, TRACKID_FX_UNAVAIL, "unavail.ogg");
-    orion_load_ogg(&g_orion, TRACKID_FX_NXSTAGE, "nxstage.ogg");
-    orion_load_ogg(&g_orion, TRACKID_FX_FAIL, "fail.ogg");
-    orion_load_ogg(&g_orion, TRACKID_FX_SPRING, "spring.ogg");
-    orion_ramp(&g_orion, TRACKID_FX_PICKUP, 0, profile.sfx_vol * VOL_VALUE);
-    orion_ramp(&g_orion, TRACKID_FX_HOP, 0, profile.sfx_vol * VOL_VALUE);
-    orion_ramp(&g_orion, TRACKID_FX_DASH, 0, profile.sfx_vol * VOL_VALUE);
-    orion_ramp(&g_orion, TRACKID_FX_UNAVAIL, 0, profile.sfx_vol * VOL_VALUE);
-    orion_ramp(&g_orion, TRACKID_FX_NXSTAGE, 0, profile.sfx_vol * VOL_VALUE);
-    orion_ramp(&g_orion, TRACKID_FX_FAIL, 0, profile.sfx_vol * VOL_VALUE);
-    orion_ramp(&g_orion, TRACKID_FX_SPRING, 0, profile.sfx_vol * VOL_VALUE);
+    orion_load_sample(&g_orion, SFXID_PICKUP, "pickup.ogg");
+    orion_load_sample(&g_orion, SFXID_HOP, "hop.ogg");
+    orion_load_sample(&g_orion, SFXID_DASH, "dash.ogg");
+    orion_load_sample(&g_orion, SFXID_UNAVAIL, "unavail.ogg");
+    orion_load_sample(&g_orion, SFXID_NXSTAGE, "nxstage.ogg");
+    orion_load_sample(&g_orion, SFXID_FAIL, "fail.ogg");
+    orion_load_sample(&g_orion, SFXID_SPRING, "spring.ogg");
+    orion_sample_volume(&g_orion, SFXID_PICKUP, profile.sfx_vol * VOL_VALUE);
+    orion_sample_volume(&g_orion, SFXID_HOP, profile.sfx_vol * VOL_VALUE);
+    orion_sample_volume(&g_orion, SFXID_DASH, profile.sfx_vol * VOL_VALUE);
+    orion_sample_volume(&g_orion, SFXID_UNAVAIL, profile.sfx_vol * VOL_VALUE);
+    orion_sample_volume(&g_orion, SFXID_NXSTAGE, profile.sfx_vol * VOL_VALUE);
+    orion_sample_volume(&g_orion, SFXID_FAIL, profile.sfx_vol * VOL_VALUE);
+    orion_sample_volume(&g_orion, SFXID_SPRING, profile.sfx_vol * VOL_VALUE);
 
     ret->prev_sim = NULL;
     ret->chap = chap;
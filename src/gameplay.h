@@ -10,6 +10,7 @@
 #include "mod.h"
 #include "label.h"
 #include "particle_sys.h"
+#include "tilemap.h"
 
 typedef struct _gameplay_scene {
     scene _base;
@@ -22,8 +23,12 @@ typedef struct _gameplay_scene {
      * (objects, dialogues, textures etc.) */
     struct stage_rec *rec;
     sim *simulator, *prev_sim;
+    tilemap *tiles, *prev_tiles;    /* Baked cells of each simulator */
     double rem_time;
     bool paused;
+    bool bgm_playing;   /* Whether stage BGM stems have been started */
+    int *bgm_tids;      /* Tracks of the stems, one for each in `chap` */
+    struct stage_rec *emit_rec; /* Stage whose audio sources are in use */
     unsigned int dialogue_triggered;
     int dialogue_idx;   /* For delayed dialogue */
 
@@ -47,7 +52,8 @@ typedef struct _gameplay_scene {
         DISP_CHAPFIN    /* End of chapter */
     } disp_state;
     double disp_time;   /* Remaining time of global animation, in seconds */
-    SDL_Texture *leadin_tex;
+    /* World layers below and above the protagonist, at native resolution */
+    SDL_Texture *world_tex[2];
 
     /* The position of the camera's top-left corner in the
      * simulated world, expressed in units */
@@ -15,6 +15,7 @@ double ease_elastic_out(double x, double p)
 }
 
 struct orion g_orion;
+int g_main_bgm[3];
 SDL_Window *g_window;
 SDL_Renderer *g_renderer;
 scene *g_stage;
@@ -12,27 +12,28 @@
 #define WIN_W   1080
 #define WIN_H   720
 
-#define TRACKID_MAIN_BGM        0
-#define TRACKID_MAIN_BGM_LP     1
-#define TRACKID_MAIN_BGM_CANON  2
-#define TRACKID_FX_FIRST        TRACKID_FX_SW1
-#define TRACKID_FX_SW1          3
-#define TRACKID_FX_SW2          4
-#define TRACKID_MENU_OPEN       5
-#define TRACKID_MENU_CLOSE      6
-#define TRACKID_MENU_CONFIRM    7
-#define TRACKID_FX_PICKUP       8
-#define TRACKID_FX_HOP          9
-#define TRACKID_FX_DASH         10
-#define TRACKID_FX_UNAVAIL      11
-#define TRACKID_FX_NXSTAGE      12
-#define TRACKID_FX_FAIL         13
-#define TRACKID_FX_SPRING       14
-#define TRACKID_FX_LAST         TRACKID_MENU_CONFIRM
-#define TRACKID_STAGE_BGM       15
-
-#define BGM_LOOP_A  (5.85 * 44100)
-#define BGM_LOOP_B  ((5.85 + 336 * 60.0 / 165) * 44100)
+/* Tracks of the main theme, created at startup */
+#define TRACKID_MAIN_BGM        (g_main_bgm[0])
+#define TRACKID_MAIN_BGM_LP     (g_main_bgm[1])
+#define TRACKID_MAIN_BGM_CANON  (g_main_bgm[2])
+
+#define SFXID_FIRST         SFXID_SW1
+#define SFXID_SW1           0
+#define SFXID_SW2           1
+#define SFXID_MENU_OPEN     2
+#define SFXID_MENU_CLOSE    3
+#define SFXID_MENU_CONFIRM  4
+#define SFXID_PICKUP        5
+#define SFXID_HOP           6
+#define SFXID_DASH          7
+#define SFXID_UNAVAIL       8
+#define SFXID_NXSTAGE       9
+#define SFXID_FAIL          10
+#define SFXID_SPRING        11
+#define SFXID_LAST          SFXID_SPRING
+
+#define BGM_LOOP_A  (5.85 * g_orion.srate)
+#define BGM_LOOP_B  ((5.85 + 336 * 60.0 / 165) * g_orion.srate)
 #define BGM_BEAT    (60.0 / 165)
 
 #define iround(__x)  ((int)((__x) + 0.5))
@@ -44,6 +45,7 @@ double clamp(double x, double l, double u);
 double ease_elastic_out(double t, double p);
 
 extern struct orion g_orion;
+extern int g_main_bgm[3];
 extern SDL_Window *g_window;
 extern SDL_Renderer *g_renderer;
 extern scene *g_stage;
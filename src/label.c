@@ -1,6 +1,8 @@
 #include "label.h"
 #include "global.h"
 #include "resources.h"
+#include "atlas.h"
+#include "batch.h"
 
 #include <assert.h>
 #include <math.h>
@@ -13,6 +15,8 @@ static const int PADDING = 2;
 #define OFFS_X(_h)  ((_h) / 25)
 #define OFFS_Y(_h)  ((_h) / 20)
 #define ARROW_W(_h) ((double)(_h) / 18)
+/* Maximum number of keys in a label */
+#define MAX_KEYS    16
 
 static unsigned long calc_hash(const char *s)
 {
@@ -23,6 +27,111 @@ static unsigned long calc_hash(const char *s)
     return ret;
 }
 
+/* Glyphs of a font, rendered into the atlas on first use */
+struct glyph_cache {
+    TTF_Font *font;
+    struct glyph {
+        bool ready;
+        texture tex;    /* Empty for blank glyphs */
+        int offs_x, adv;
+    } g[256];
+};
+static struct glyph_cache **caches = NULL;
+static int n_caches = 0;
+
+static struct glyph *get_glyph(TTF_Font *font, unsigned char ch)
+{
+    struct glyph_cache *c = NULL;
+    int i;
+    for (i = 0; i < n_caches; ++i)
+        if (caches[i]->font == font) { c = caches[i]; break; }
+    if (c == NULL) {
+        c = calloc(1, sizeof(struct glyph_cache));
+        c->font = font;
+        caches = realloc(caches, sizeof(struct glyph_cache *) * (n_caches + 1));
+        caches[n_caches++] = c;
+    }
+
+    struct glyph *g = &c->g[ch];
+    if (!g->ready) {
+        int minx;
+        g->ready = true;
+        if (TTF_GlyphMetrics(font, ch, &minx, NULL, NULL, NULL, &g->adv) != 0)
+            return g;
+        /* The glyph is rendered to the right of the origin
+         * if it extends to the left */
+        g->offs_x = (minx < 0 ? minx : 0);
+        if (ch == ' ') return g;
+        /* White, to be tinted when drawn */
+        SDL_Surface *sf = TTF_RenderGlyph_Blended(font, ch,
+            (SDL_Color){255, 255, 255, 255});
+        if (sf != NULL) {
+            g->tex = atlas_add(sf);
+            SDL_FreeSurface(sf);
+        }
+    }
+    return g;
+}
+
+static inline void add_glyph(label *this, texture tex, int x, int y,
+    SDL_Color cl, int pos)
+{
+    if (this->n_glyphs == this->cap_glyphs) {
+        this->cap_glyphs = (this->cap_glyphs == 0 ? 16 : this->cap_glyphs * 2);
+        this->glyphs = realloc(this->glyphs,
+            sizeof(label_glyph) * this->cap_glyphs);
+    }
+    this->glyphs[this->n_glyphs++] = (label_glyph){
+        tex, (SDL_Rect){x, y, tex.range.w, tex.range.h}, cl, pos
+    };
+}
+
+/* Places glyphs of the text in the given font, wrapping at spaces
+ * like SDL_ttf does; the size of the laid out text is returned.
+ * If `marks` is not NULL, positions of backquotes are stored into it */
+static void layout_text(label *this, TTF_Font *font, SDL_Color cl,
+    SDL_Point *marks, int *n_marks, int *w, int *h)
+{
+    const unsigned char *s = (const unsigned char *)this->text;
+    int x = 0, y = 0, skip = TTF_FontLineSkip(font);
+    *w = 0;
+    while (*s != '\0') {
+        if (*s == '\n') {
+            x = 0;
+            y += skip;
+            ++s;
+            continue;
+        }
+        /* Measure the next word along with the spaces before it */
+        const unsigned char *e = s;
+        int ww = 0;
+        while (*e == ' ') ww += get_glyph(font, *(e++))->adv;
+        while (*e != '\0' && *e != ' ' && *e != '\n')
+            ww += get_glyph(font, *(e++))->adv;
+        if (x > 0 && x + ww > this->wid) {
+            /* Move to the next line without the spaces */
+            x = 0;
+            y += skip;
+            while (*s == ' ') ++s;
+            continue;
+        }
+        for (; s < e; ++s) {
+            struct glyph *g = get_glyph(font, *s);
+            if (*s == '`' && marks != NULL && *n_marks < MAX_KEYS)
+                marks[(*n_marks)++] = (SDL_Point){x, y};
+            if (g->tex.sdl_tex != NULL) {
+                add_glyph(this, g->tex, x + g->offs_x, y, cl,
+                    s - (const unsigned char *)this->text);
+                if (*w < x + g->offs_x + g->tex.range.w)
+                    *w = x + g->offs_x + g->tex.range.w;
+            }
+            x += g->adv;
+        }
+        if (*w < x) *w = x;
+    }
+    *h = y + TTF_FontHeight(font);
+}
+
 static void label_render_text(label *this)
 {
     /* The exact same text needn't be updated */
@@ -30,26 +139,31 @@ static void label_render_text(label *this)
     if (hash == this->last_hash) return;
     this->last_hash = hash;
 
-    if (this->_base.tex.sdl_tex != NULL)
-        SDL_DestroyTexture(this->_base.tex.sdl_tex);
-
-    SDL_Surface *sf = TTF_RenderText_Blended_Wrapped(
-        this->font, this->text, this->cl, this->wid
-    );
+    /* The outline goes below the text, both starting from the origin */
+    int w = 0, h = 0, w1, h1;
+    this->n_glyphs = 0;
+    if (this->font_outline != NULL)
+        layout_text(this, this->font_outline, this->cl_outline, NULL, NULL, &w, &h);
+    layout_text(this, this->font, this->cl, NULL, NULL, &w1, &h1);
+    this->_base._base.dim.w = (w > w1 ? w : w1);
+    this->_base._base.dim.h = (h > h1 ? h : h1);
+}
 
-    if (this->font_outline != NULL) {
-        SDL_Surface *osf = TTF_RenderText_Blended_Wrapped(
-            this->font_outline, this->text, this->cl_outline, this->wid
-        );
-        SDL_BlitSurface(sf, NULL, osf, NULL);
-        SDL_FreeSurface(sf);
-        sf = osf;
+static void label_draw(label *this)
+{
+    SDL_Rect *dim = &this->_base._base.dim;
+    int i;
+    for (i = 0; i < this->n_glyphs; ++i) {
+        label_glyph *g = &this->glyphs[i];
+        if (this->n_visible >= 0 && g->pos >= this->n_visible) continue;
+        batch_copy(g->tex.sdl_tex, &g->tex.range, &(SDL_Rect){
+            dim->x + g->dst.x, dim->y + g->dst.y, g->dst.w, g->dst.h
+        }, (SDL_Color){
+            g->cl.r * this->mod.r / 255, g->cl.g * this->mod.g / 255,
+            g->cl.b * this->mod.b / 255, this->_base.alpha
+        });
     }
-    this->_base.tex =
-        temp_texture(SDL_CreateTextureFromSurface(g_renderer, sf));
-    this->_base._base.dim.w = this->_base.tex.range.w;
-    this->_base._base.dim.h = this->_base.tex.range.h;
-    SDL_FreeSurface(sf);
+    batch_flush();
 }
 
 static inline int get_arrow_dir(const char ch)
@@ -123,110 +237,126 @@ static inline int arrow_pixel_opacity(int dir, int sz, double w, int x, int y)
     }
 }
 
-static void label_render_keyed_text(label *this, const char *keys)
+/* Renders the icon of a key; `h` is the height and the diameter */
+static SDL_Surface *render_icon(char key, int h)
 {
-    /* Don't need to use caching for this type */
-    if (this->_base.tex.sdl_tex != NULL)
-        SDL_DestroyTexture(this->_base.tex.sdl_tex);
-
-    SDL_Surface *sf = TTF_RenderText_Blended_Wrapped(
-        this->font, this->text, this->cl, this->wid
-    );
-
+    SDL_Surface *sf = SDL_CreateRGBSurfaceWithFormat(
+        0, h, h, 32, SDL_PIXELFORMAT_ARGB8888);
     if (SDL_MUSTLOCK(sf)) SDL_LockSurface(sf);
-    assert(sf->format->format == SDL_PIXELFORMAT_ARGB8888);
-
-    /* Process text for keys */
-    char *s = strdup(this->text);
-    char *t = s - 1;
-    int n = 0;  /* Number of replacements performed */
-    while ((t = strchr(t + 1, '`')) != NULL) {
-        char orig_t = *t;
-        *t = '\0';
-        int x;
-        TTF_SizeText(this->font, s, &x, NULL);
-
-        int h = sf->h - PADDING * 2;
-        /* Render the key icon */
-        SDL_Surface *tsf = NULL;
-        int arrow_dir;
-        if ((arrow_dir = get_arrow_dir(keys[n])) != -1) {
-            int w = STROKE_W(h);
-            tsf = SDL_CreateRGBSurfaceWithFormat(
-                0, h, h, 32, SDL_PIXELFORMAT_ARGB8888);
-            int i, j;
-            for (i = 0; i < h; ++i)
-                for (j = 0; j < h; ++j)
-                    *((Uint32 *)(tsf->pixels + i * tsf->pitch) + j) =
-                        arrow_pixel_opacity(arrow_dir, h - w * 2, ARROW_W(h), j - w, i - w) << 24;
-        } else if (keys[n] == '~') {
-            tsf = TTF_RenderText_Blended(
-                load_font(FONT_UPRIGHT, KEY_PTS(h) * 0.6), "ESC", (SDL_Color){0});
-        } else {
-            tsf = TTF_RenderGlyph_Blended(
-                load_font(FONT_UPRIGHT, KEY_PTS(h)), keys[n], (SDL_Color){0});
-        }
-        /* Draw a circle; `h` is the height and the radius */
-        int x0 = (h - tsf->w - 1) / 2 + (arrow_dir == -1 ? OFFS_X(h) : 0),
-            y0 = (h - tsf->h - 1) / 2 + (arrow_dir == -1 ? OFFS_Y(h) : 0),
-            w = STROKE_W(h);
+
+    SDL_Surface *tsf = NULL;
+    int arrow_dir;
+    if ((arrow_dir = get_arrow_dir(key)) != -1) {
+        int w = STROKE_W(h);
+        tsf = SDL_CreateRGBSurfaceWithFormat(
+            0, h, h, 32, SDL_PIXELFORMAT_ARGB8888);
         int i, j;
-        for (i = -PADDING; i < h + PADDING; ++i)
-            for (j = -PADDING; j < h; ++j) {
-                if (j + x + PADDING - h / 2 < 0 ||
-                    j + x + PADDING - h / 2 >= sf->w)
-                {
-                    continue;
-                }
-                /* `j` does not exceed `h`, so that
-                 * the succeeding characters won't be erased */
-                Uint32 pix = 0x0;   /* Transparent */
-                double d = sqrt(sqr(i + 0.5 - h * 0.5) + sqr(j + 0.5 - h * 0.5));
-                if (d <= h * 0.5 - 1 - w) {
-                    /* White */
-                    pix = 0xffffffff;
-                    if (i >= y0 && i < y0 + tsf->h && j >= x0 && j < x0 + tsf->w) {
-                        Uint32 tsf_pix =
-                            *((Uint32 *)(tsf->pixels + (i - y0) * tsf->pitch) + j - x0);
-                        int grey = (tsf_pix & (tsf->format->Amask)) >> tsf->format->Ashift;
-                        grey = 255 - grey;
-                        if (grey != 255)
-                            pix = 0xff000000 | (grey << 16) | (grey << 8) | grey;
-                    }
-                } else if (d <= h * 0.5 - w) {
-                    /* White-black gradient */
-                    int grey = iround((h * 0.5 - w - d) * 255);
-                    pix = 0xff000000 | (grey << 16) | (grey << 8) | grey;
-                } else if (d <= h * 0.5 - 1) {
-                    /* Black */
-                    pix = 0xff000000;
-                } else if (d <= h * 0.5) {
-                    /* Black-transparent gradient */
-                    int alpha = iround((h * 0.5 - d) * 255);
-                    pix = (alpha << 24) | 0x0;
+        for (i = 0; i < h; ++i)
+            for (j = 0; j < h; ++j)
+                *((Uint32 *)(tsf->pixels + i * tsf->pitch) + j) =
+                    arrow_pixel_opacity(arrow_dir, h - w * 2, ARROW_W(h), j - w, i - w) << 24;
+    } else if (key == '~') {
+        tsf = TTF_RenderText_Blended(
+            load_font(FONT_UPRIGHT, KEY_PTS(h) * 0.6), "ESC", (SDL_Color){0});
+    } else {
+        tsf = TTF_RenderGlyph_Blended(
+            load_font(FONT_UPRIGHT, KEY_PTS(h)), key, (SDL_Color){0});
+    }
+    /* Draw a circle with the key inside */
+    int x0 = (h - tsf->w - 1) / 2 + (arrow_dir == -1 ? OFFS_X(h) : 0),
+        y0 = (h - tsf->h - 1) / 2 + (arrow_dir == -1 ? OFFS_Y(h) : 0),
+        w = STROKE_W(h);
+    int i, j;
+    for (i = 0; i < h; ++i)
+        for (j = 0; j < h; ++j) {
+            Uint32 pix = 0x0;   /* Transparent */
+            double d = sqrt(sqr(i + 0.5 - h * 0.5) + sqr(j + 0.5 - h * 0.5));
+            if (d <= h * 0.5 - 1 - w) {
+                /* White */
+                pix = 0xffffffff;
+                if (i >= y0 && i < y0 + tsf->h && j >= x0 && j < x0 + tsf->w) {
+                    Uint32 tsf_pix =
+                        *((Uint32 *)(tsf->pixels + (i - y0) * tsf->pitch) + j - x0);
+                    int grey = (tsf_pix & (tsf->format->Amask)) >> tsf->format->Ashift;
+                    grey = 255 - grey;
+                    if (grey != 255)
+                        pix = 0xff000000 | (grey << 16) | (grey << 8) | grey;
                 }
-                *((Uint32 *)(sf->pixels + sf->pitch * (i + PADDING)) +
-                    (j + x + PADDING - h / 2)) = pix;
+            } else if (d <= h * 0.5 - w) {
+                /* White-black gradient */
+                int grey = iround((h * 0.5 - w - d) * 255);
+                pix = 0xff000000 | (grey << 16) | (grey << 8) | grey;
+            } else if (d <= h * 0.5 - 1) {
+                /* Black */
+                pix = 0xff000000;
+            } else if (d <= h * 0.5) {
+                /* Black-transparent gradient */
+                int alpha = iround((h * 0.5 - d) * 255);
+                pix = (alpha << 24) | 0x0;
             }
-
-        ++n;
-        *t = orig_t;
-        SDL_FreeSurface(tsf);
-    }
-    free(s);
+            *((Uint32 *)(sf->pixels + sf->pitch * i) + j) = pix;
+        }
+    SDL_FreeSurface(tsf);
 
     if (SDL_MUSTLOCK(sf)) SDL_UnlockSurface(sf);
+    return sf;
+}
 
-    this->_base.tex =
-        temp_texture(SDL_CreateTextureFromSurface(g_renderer, sf));
+/* Icons of keys, rendered into the atlas on first use */
+static struct icon {
+    char key;
+    int h;
+    texture tex;
+} *icons = NULL;
+static int n_icons = 0;
+
+static texture get_icon(char key, int h)
+{
+    int i;
+    for (i = 0; i < n_icons; ++i)
+        if (icons[i].key == key && icons[i].h == h) return icons[i].tex;
+    SDL_Surface *sf = render_icon(key, h);
+    icons = realloc(icons, sizeof(struct icon) * (n_icons + 1));
+    icons[n_icons] = (struct icon){key, h, atlas_add(sf)};
     SDL_FreeSurface(sf);
-    this->_base._base.dim.w = this->_base.tex.range.w;
-    this->_base._base.dim.h = this->_base.tex.range.h;
+    return icons[n_icons++].tex;
+}
+
+static void label_render_keyed_text(label *this, const char *keys)
+{
+    /* Don't need to use caching for this type */
+    this->last_hash = 0;
+
+    SDL_Point marks[MAX_KEYS];
+    int n_marks = 0, w, h;
+    this->n_glyphs = 0;
+    layout_text(this, this->font, this->cl, marks, &n_marks, &w, &h);
+
+    int sz = TTF_FontHeight(this->font) - PADDING * 2;
+    int i, j, k;
+    for (i = 0; i < n_marks && keys[i] != '\0'; ++i) {
+        int x = marks[i].x + PADDING - sz / 2, y = marks[i].y + PADDING;
+        /* The icon covers the text around the mark */
+        int x1 = marks[i].x - sz / 2, x2 = x + sz;
+        for (j = k = 0; j < this->n_glyphs; ++j) {
+            label_glyph *g = &this->glyphs[j];
+            int c = g->dst.x + g->dst.w / 2;
+            if (g->dst.y != marks[i].y || c < x1 || c >= x2)
+                this->glyphs[k++] = *g;
+        }
+        this->n_glyphs = k;
+        add_glyph(this, get_icon(keys[i], sz), x, y,
+            (SDL_Color){255, 255, 255, 255}, 0);
+        if (w < x + sz) w = x + sz;
+    }
+
+    this->_base._base.dim.w = w;
+    this->_base._base.dim.h = h;
 }
 
 static void label_drop(label *this)
 {
-    SDL_DestroyTexture(this->_base.tex.sdl_tex);
+    free(this->glyphs);
 }
 
 static inline label *label_create_basic(int font_id, int pts,
@@ -234,7 +364,12 @@ static inline label *label_create_basic(int font_id, int pts,
 {
     label *ret = (label *)sprite_create_empty();
     ret = realloc(ret, sizeof(label));
+    ret->_base._base.draw = (element_draw_func)label_draw;
     ret->_base._base.drop = (element_drop_func)label_drop;
+    ret->mod = (SDL_Color){255, 255, 255, 255};
+    ret->glyphs = NULL;
+    ret->n_glyphs = ret->cap_glyphs = 0;
+    ret->n_visible = -1;
     ret->font = load_font(font_id, pts);
     ret->cl = cl;
     ret->wid = wid;
@@ -277,5 +412,10 @@ void label_set_keyed_text(label *this, const char *text, const char *keys)
 
 void label_colour_mod(label *this, Uint8 r, Uint8 g, Uint8 b)
 {
-    SDL_SetTextureColorMod(this->_base.tex.sdl_tex, r, g, b);
+    this->mod = (SDL_Color){r, g, b, 255};
+}
+
+void label_set_visible(label *this, int n)
+{
+    this->n_visible = n;
 }
@@ -4,16 +4,31 @@
 #define _LABEL_H
 
 #include "element.h"
+#include "resources.h"
 
 #include <SDL_ttf.h>
 
+/* A glyph placed relative to the label */
+typedef struct _label_glyph {
+    texture tex;
+    SDL_Rect dst;
+    SDL_Color cl;
+    int pos;    /* Index of the character in the text */
+} label_glyph;
+
+/* Text is drawn as glyphs from an atlas, laid out when the text changes;
+ * in keyed text, each backquote is replaced by the icon of a key */
 typedef struct _label {
     sprite _base;
     TTF_Font *font, *font_outline;
     SDL_Color cl, cl_outline;
+    SDL_Color mod;  /* Colour modulation */
     const char *text;
     int wid;
     unsigned long last_hash;
+    label_glyph *glyphs;
+    int n_glyphs, cap_glyphs;
+    int n_visible;  /* Number of leading characters drawn; -1 for all */
 } label;
 
 label *label_create(int font_id, int pts,
@@ -23,5 +38,8 @@ label *label_create_outlined(int font_id, int font_outline_id, int pts,
 void label_set_text(label *this, const char *text);
 void label_set_keyed_text(label *this, const char *text, const char *keys);
 void label_colour_mod(label *this, Uint8 r, Uint8 g, Uint8 b);
+/* Shows only the first `n` characters without laying out the text again;
+ * -1 shows all of them. Kept when the text changes */
+void label_set_visible(label *this, int n);
 
 #endif
@@ -3,6 +3,7 @@
 #include "scene.h"
 #include "transition.h"
 #include "resources.h"
+#include "atlas.h"
 #include "profile_data.h"
 #include "intro.h"
 #include "overworld.h"
@@ -52,7 +53,9 @@ int main(int argc, char *argv[])
 
     load_images();
 
-    g_orion = orion_create(44100, 2);
+    g_orion = orion_create_ex(0, 2, 0, ORION_LATENCY_LOW);
+    int i;
+    for (i = 0; i < 3; ++i) g_main_bgm[i] = orion_track_create(&g_orion);
 
 #ifdef NDEBUG
     g_stage = (scene *)intro_scene_create();
@@ -92,12 +95,22 @@ int main(int argc, char *argv[])
         ++fps_frame_count;
         if (fps_last_flush / 1000 != SDL_GetTicks() / 1000) {
             printf("%d FPS\n", fps_frame_count);
+#ifndef NDEBUG
+            struct orion_stats st;
+            orion_get_stats(&g_orion, &st);
+            size_t pcm_idle, pcm_total = orion_cache_usage(&g_orion, &pcm_idle);
+            printf("Audio: %d frames/buffer, %ld underruns, load %.1f%% avg %.1f%% max, "
+                "%zu KiB data (%zu KiB idle)\n",
+                st.buf_frames, st.underruns, st.load_avg * 100, st.load_max * 100,
+                pcm_total >> 10, pcm_idle >> 10);
+#endif
             fps_frame_count = 0;
         }
         fps_last_flush = SDL_GetTicks();
     }
 
     orion_drop(&g_orion);
+    atlas_release();
     release_images();
     TTF_Quit();
     IMG_Quit();
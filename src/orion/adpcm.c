@@ -0,0 +1,123 @@
+#include "adpcm.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+static const int STEP[89] = {
+    7, 8, 9, 10, 11, 12, 13, 14, 16, 17, 19, 21, 23, 25, 28, 31, 34, 37, 41,
+    45, 50, 55, 60, 66, 73, 80, 88, 97, 107, 118, 130, 143, 157, 173, 190,
+    209, 230, 253, 279, 307, 337, 371, 408, 449, 494, 544, 598, 658, 724,
+    796, 876, 963, 1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066, 2272,
+    2499, 2749, 3024, 3327, 3660, 4026, 4428, 4871, 5358, 5894, 6484, 7132,
+    7845, 8630, 9493, 10442, 11487, 12635, 13899, 15289, 16818, 18500,
+    20350, 22385, 24623, 27086, 29794, 32767
+};
+
+static const int INDEX[16] = {
+    -1, -1, -1, -1, 2, 4, 6, 8,
+    -1, -1, -1, -1, 2, 4, 6, 8
+};
+
+/* Applies a nibble to the decoder state */
+static inline void step(int *pred, int *idx, int n)
+{
+    int s = STEP[*idx], diff = s >> 3;
+    if (n & 4) diff += s;
+    if (n & 2) diff += s >> 1;
+    if (n & 1) diff += s >> 2;
+    *pred += (n & 8) ? -diff : diff;
+    if (*pred > 32767) *pred = 32767;
+    else if (*pred < -32768) *pred = -32768;
+    *idx += INDEX[n];
+    if (*idx < 0) *idx = 0;
+    else if (*idx > 88) *idx = 88;
+}
+
+/* Picks the nibble bringing the decoder closest to `x` and applies it */
+static inline int encode_one(int *pred, int *idx, int x)
+{
+    int s = STEP[*idx], diff = x - *pred, n = 0;
+    if (diff < 0) {
+        n = 8;
+        diff = -diff;
+    }
+    if (diff >= s) { n |= 4; diff -= s; }
+    if (diff >= s >> 1) { n |= 2; diff -= s >> 1; }
+    if (diff >= s >> 2) n |= 1;
+    step(pred, idx, n);
+    return n;
+}
+
+size_t orion_adpcm_size(int nch, int nsmp)
+{
+    size_t nblk = (nsmp + ORION_ADPCM_BLOCK - 1) / ORION_ADPCM_BLOCK;
+    return nblk * ORION_ADPCM_BLOCK_BYTES(nch);
+}
+
+void orion_adpcm_encode(int nch, int nsmp, const short *in, unsigned char *out)
+{
+    short pad[ORION_ADPCM_BLOCK * ORION_ADPCM_MAXCH];
+    /* The step index carries over blocks, only the predictor is reset;
+     * it starts from the first difference to avoid a slow attack */
+    int idx[ORION_ADPCM_MAXCH] = { 0 };
+    int b, c, i;
+    for (c = 0; c < nch && nsmp >= 2; ++c) {
+        int d = in[nch + c] - in[c];
+        while (idx[c] < 88 && STEP[idx[c]] < abs(d)) ++idx[c];
+    }
+    for (b = 0; b < nsmp; b += ORION_ADPCM_BLOCK) {
+        const short *src = in + (size_t)b * nch;
+        if (nsmp - b < ORION_ADPCM_BLOCK) {
+            /* Zero-fill the last block */
+            memset(pad, 0, sizeof pad);
+            memcpy(pad, src, sizeof(short) * (nsmp - b) * nch);
+            src = pad;
+        }
+        for (c = 0; c < nch; ++c) {
+            int pred = src[c];
+            out[0] = pred & 0xff;
+            out[1] = (pred >> 8) & 0xff;
+            out[2] = idx[c];
+            out[3] = 0;
+            out += 4;
+            memset(out, 0, ORION_ADPCM_BLOCK / 2);
+            for (i = 1; i < ORION_ADPCM_BLOCK; ++i) {
+                int n = encode_one(&pred, &idx[c], src[i * nch + c]);
+                out[(i - 1) >> 1] |= n << (((i - 1) & 1) * 4);
+            }
+            out += ORION_ADPCM_BLOCK / 2;
+        }
+    }
+}
+
+void orion_adpcm_decode_block(int nch, const unsigned char *blk, short *out)
+{
+    int c, i;
+    for (c = 0; c < nch; ++c) {
+        int pred = (short)(blk[0] | (blk[1] << 8));
+        int idx = blk[2];
+        if (idx > 88) idx = 88;
+        blk += 4;
+        out[c] = pred;
+        for (i = 1; i < ORION_ADPCM_BLOCK; ++i) {
+            step(&pred, &idx, (blk[(i - 1) >> 1] >> (((i - 1) & 1) * 4)) & 15);
+            out[i * nch + c] = pred;
+        }
+        blk += ORION_ADPCM_BLOCK / 2;
+    }
+}
+
+void orion_adpcm_decode(int nch, int nsmp, const unsigned char *in, short *out)
+{
+    short pad[ORION_ADPCM_BLOCK * ORION_ADPCM_MAXCH];
+    int b;
+    for (b = 0; b < nsmp; b += ORION_ADPCM_BLOCK) {
+        if (nsmp - b >= ORION_ADPCM_BLOCK) {
+            orion_adpcm_decode_block(nch, in, out + (size_t)b * nch);
+        } else {
+            orion_adpcm_decode_block(nch, in, pad);
+            memcpy(out + (size_t)b * nch, pad, sizeof(short) * (nsmp - b) * nch);
+        }
+        in += ORION_ADPCM_BLOCK_BYTES(nch);
+    }
+}
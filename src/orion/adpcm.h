@@ -0,0 +1,35 @@
+#ifndef _ORION_ADPCM_H
+#define _ORION_ADPCM_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* IMA-ADPCM with independently decodable blocks, for random access.
+ * Each channel of a block starts with a 4-byte header holding the first
+ * sample as is and the step index, followed by one nibble per sample. */
+
+/* Number of samples per block */
+#define ORION_ADPCM_BLOCK   256
+/* Maximum number of channels supported */
+#define ORION_ADPCM_MAXCH   2
+/* Size of a block; in bytes */
+#define ORION_ADPCM_BLOCK_BYTES(__nch)  ((__nch) * (4 + ORION_ADPCM_BLOCK / 2))
+
+/* Size of the encoded data; in bytes
+ * nsmp - number of samples; a stereo sample is considered 1 sample */
+size_t orion_adpcm_size(int nch, int nsmp);
+/* Encodes interleaved audio; `out` should hold `orion_adpcm_size()` bytes */
+void orion_adpcm_encode(int nch, int nsmp, const short *in, unsigned char *out);
+/* Decodes one block into `ORION_ADPCM_BLOCK` interleaved samples */
+void orion_adpcm_decode_block(int nch, const unsigned char *blk, short *out);
+/* Decodes all blocks; `out` should hold `nsmp` interleaved samples */
+void orion_adpcm_decode(int nch, int nsmp, const unsigned char *in, short *out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,53 @@
+#ifndef _ORION_BIQUAD_H
+#define _ORION_BIQUAD_H
+
+#include <math.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Coefficients of a biquad section, normalized so that a0 = 1 */
+struct orion_biquad {
+    float b0, b1, b2, a1, a2;
+};
+
+/* Number of sections in a 4th-order Butterworth cascade,
+ * and the Q factor of each of them */
+#define ORION_BUTTERWORTH_SECTIONS  2
+static const double ORION_BUTTERWORTH_Q[ORION_BUTTERWORTH_SECTIONS] = {
+    0.54119610014619698, 1.3065629648763766
+};
+
+/* Designs a lowpass section; see the RBJ Audio EQ Cookbook */
+static inline void orion_biquad_lowpass(struct orion_biquad *bq,
+    double srate, double cutoff, double q)
+{
+    /* Cutoffs at or above Nyquist make the bilinear transform blow up */
+    if (cutoff > srate * 0.49) cutoff = srate * 0.49;
+    if (cutoff < 1) cutoff = 1;
+    double w0 = 2 * M_PI * cutoff / srate;
+    double cs = cos(w0), alpha = sin(w0) / (2 * q);
+    double a0 = 1 + alpha;
+    bq->b0 = (float)((1 - cs) / 2 / a0);
+    bq->b1 = (float)((1 - cs) / a0);
+    bq->b2 = bq->b0;
+    bq->a1 = (float)(-2 * cs / a0);
+    bq->a2 = (float)((1 - alpha) / a0);
+}
+
+/* Runs one sample through a section in transposed direct form II;
+ * `z` holds the two state variables */
+static inline float orion_biquad_run(const struct orion_biquad *bq, float *z, float x)
+{
+    float y = bq->b0 * x + z[0];
+    z[0] = bq->b1 * x - bq->a1 * y + z[1];
+    z[1] = bq->b2 * x - bq->a2 * y;
+    return y;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
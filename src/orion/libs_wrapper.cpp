@@ -1,47 +1,86 @@
 #include "libs_wrapper.h"
+#include "biquad.h"
 #include <soundtouch/SoundTouch.h>
-#include <Iir.h>
 #include <stdlib.h>
+#include <thread>
+#include <vector>
 
-void st_change_tempo(int srate, double delta_pc, int nch, int nsmp, char *inbuf, int *rnsmp, char **outbuf)
-{
-    // Setup
+struct st_stream {
     soundtouch::SoundTouch st;
-    st.setSampleRate(srate);
-    st.setChannels(nch);
-    st.setTempoChange(delta_pc);
-    st.setSetting(SETTING_USE_QUICKSEEK, 0);
-    st.setSetting(SETTING_USE_AA_FILTER, 1);
-
-    // Mental preparation... wait, memory setup
-    double ratio = st.getInputOutputSampleRatio();
-    size_t rcap = (size_t)(nsmp * ratio) + 10;
-    size_t rcap_mem = rcap * sizeof(soundtouch::SAMPLETYPE);
-    // Use malloc() instead of new, for we'll need to call free() from C
-    soundtouch::SAMPLETYPE *obuf = (soundtouch::SAMPLETYPE *)malloc(rcap_mem);
-
-    // Processing
-    unsigned int ibufptr = 0, obufptr = 0;
+    int nch;
+};
+
+struct st_stream *st_stream_create(int srate, double delta_pc, int nch)
+{
+    st_stream *s = new st_stream;
+    s->nch = nch;
+    s->st.setSampleRate(srate);
+    s->st.setChannels(nch);
+    s->st.setTempoChange(delta_pc);
+    s->st.setSetting(SETTING_USE_QUICKSEEK, 0);
+    s->st.setSetting(SETTING_USE_AA_FILTER, 1);
+    return s;
+}
+
+double st_stream_ratio(struct st_stream *s)
+{
+    return s->st.getInputOutputSampleRatio();
+}
+
+int st_stream_process(struct st_stream *s, int nsmp, const char *inbuf, int last, int cap, char *outbuf)
+{
+    soundtouch::SAMPLETYPE *obuf = (soundtouch::SAMPLETYPE *)outbuf;
+    int nch = s->nch, obufptr = 0;
     unsigned int nrecv;
-    const int CHUNK_SZ = 6720;
-    while (ibufptr < nsmp) {
-        unsigned int putsz = (nsmp - ibufptr) / nch;
-        if (putsz > CHUNK_SZ) putsz = CHUNK_SZ;
-        st.putSamples(((const soundtouch::SAMPLETYPE *)inbuf) + ibufptr, putsz);
-        ibufptr += putsz * nch;
-        do {
-            nrecv = st.receiveSamples(obuf + obufptr, (rcap - obufptr) / nch);
-            obufptr += nrecv * nch;
-        } while (nrecv != 0);
-    }
-    st.flush();
-    do {
-        nrecv = st.receiveSamples(obuf + obufptr, (rcap - obufptr) / nch);
+    if (nsmp > 0)
+        s->st.putSamples((const soundtouch::SAMPLETYPE *)inbuf, nsmp / nch);
+    if (last) s->st.flush();
+    // Anything not fitting in outbuf is kept for the next call
+    while (obufptr < cap && (nrecv = s->st.receiveSamples(obuf + obufptr, (cap - obufptr) / nch)) != 0)
         obufptr += nrecv * nch;
-    } while (nrecv != 0);
+    return obufptr;
+}
 
-    *rnsmp = obufptr;
-    *outbuf = (char *)obuf;
+void st_stream_drop(struct st_stream *s)
+{
+    delete s;
+}
+
+// Channels are filtered in blocks of this many samples
+static const int IIR_BLOCK = 4096;
+
+// Filters every nch-th sample starting from inbuf, writing to the same
+// positions in outbuf; deinterleaves into a float block to keep the loop tight
+static void iir_lowpass_channel(const orion_biquad *sec, int nch, int len,
+    const short *ibuf, short *obuf)
+{
+    float x[IIR_BLOCK];
+    float z[ORION_BUTTERWORTH_SECTIONS][2] = {{0}};
+    for (int start = 0; start < len; start += IIR_BLOCK) {
+        int n = len - start < IIR_BLOCK ? len - start : IIR_BLOCK;
+        const short *in = ibuf + (size_t)start * nch;
+        short *out = obuf + (size_t)start * nch;
+        for (int i = 0; i < n; ++i) x[i] = in[i * nch];
+        // One section at a time over the whole block
+        for (int k = 0; k < ORION_BUTTERWORTH_SECTIONS; ++k) {
+            const orion_biquad bq = sec[k];
+            float z0 = z[k][0], z1 = z[k][1];
+            for (int i = 0; i < n; ++i) {
+                float y = bq.b0 * x[i] + z0;
+                z0 = bq.b1 * x[i] - bq.a1 * y + z1;
+                z1 = bq.b2 * x[i] - bq.a2 * y;
+                x[i] = y;
+            }
+            z[k][0] = z0;
+            z[k][1] = z1;
+        }
+        for (int i = 0; i < n; ++i) {
+            float y = x[i] + (x[i] >= 0 ? 0.5f : -0.5f);
+            if (y > 32767) y = 32767;
+            else if (y < -32768) y = -32768;
+            out[i * nch] = (short)y;
+        }
+    }
 }
 
 void iir_lowpass(int srate, double cutoff, int nch, int nsmp, char *inbuf, char **outbuf)
@@ -49,13 +88,17 @@ void iir_lowpass(int srate, double cutoff, int nch, int nsmp, char *inbuf, char
     short *ibuf = (short *)inbuf,
         *obuf = (short *)malloc(nsmp * sizeof(short));
 
-    Iir::Butterworth::LowPass<4> lp[nch];
-    for (int i = 0; i < nch; ++i)
-        lp[i].setup(4, srate, cutoff);
-    for (int i = 0; i < nsmp; ++i) {
-        double o = lp[i % nch].filter((double)ibuf[i] / 0x8000u);
-        obuf[i] = (short)(o * 0x8000u);
-    }
+    orion_biquad sec[ORION_BUTTERWORTH_SECTIONS];
+    for (int k = 0; k < ORION_BUTTERWORTH_SECTIONS; ++k)
+        orion_biquad_lowpass(&sec[k], srate, cutoff, ORION_BUTTERWORTH_Q[k]);
+
+    // Each channel on its own thread; the first one on the calling thread
+    int len = nsmp / nch;
+    std::vector<std::thread> workers;
+    for (int c = 1; c < nch; ++c)
+        workers.emplace_back(iir_lowpass_channel, sec, nch, len, ibuf + c, obuf + c);
+    iir_lowpass_channel(sec, nch, len, ibuf, obuf);
+    for (auto &w : workers) w.join();
 
     *outbuf = (char *)obuf;
 }
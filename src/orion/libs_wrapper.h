@@ -6,13 +6,21 @@ extern "C" {
 #endif
 
 // Formats according to SoundTouch compilation (should be 16-bit)
-// Outputs in rnsmp and outbuf; outbuf needs to be free()'d
+// Changes tempo while keeping pitch, processing a long input in chunks
 // nch - number of channels
-// nsmp - number of samples in inbuf. A stereo sample is considered 2 samples
-void st_change_tempo(int srate, double delta_pc, int nch, int nsmp, char *inbuf, int *rnsmp, char **outbuf);
+struct st_stream;
+struct st_stream *st_stream_create(int srate, double delta_pc, int nch);
+// Ratio of the output length to the input length
+double st_stream_ratio(struct st_stream *s);
+// Feeds nsmp samples from inbuf, then receives at most cap samples to outbuf
+// Remaining output is flushed if last is nonzero
+// Returns the number of samples received; a stereo sample is considered 2 samples
+int st_stream_process(struct st_stream *s, int nsmp, const char *inbuf, int last, int cap, char *outbuf);
+void st_stream_drop(struct st_stream *s);
 
+// 4th-order Butterworth lowpass; channels are filtered in parallel
 // Assumes 16-bit signed integer
-// Outputs in rnsmp and outbuf; outbuf needs to be free()'d
+// Outputs in outbuf, which needs to be free()'d
 // cutoff - cutoff frequency in Hz
 void iir_lowpass(int srate, double cutoff, int nch, int nsmp, char *inbuf, char **outbuf);
 
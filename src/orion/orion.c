@@ -1,36 +1,61 @@
 #include "orion.h"
+#include "resample.h"
 
 #include <vorbis/vorbisfile.h>
 #include <SDL.h>
 #include <portaudio.h>
 
+#include <limits.h>
+#include <math.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
 #define IS_BIGENDIAN    (!*(unsigned char *)&(uint16_t){1})
 #define IS_SIGNED(__t)  ((__t)0 - 1 < 0)
 
+#define TRACK_IDX_MASK  ((1 << ORION_TRACK_IDX_BITS) - 1)
+#define TRACK_GEN_MASK  ((1 << (31 - ORION_TRACK_IDX_BITS)) - 1)
+
 struct orion orion_create(int srate, int nch)
 {
+    return orion_create_ex(srate, nch, 64, ORION_LATENCY_LOW);
+}
+
+/* Returns the default output device's native sample rate */
+static int _orion_device_srate()
+{
+    int ret = 44100;
+    if (Pa_Initialize() != paNoError) return ret;
+    PaDeviceIndex dev = Pa_GetDefaultOutputDevice();
+    if (dev != paNoDevice && Pa_GetDeviceInfo(dev)->defaultSampleRate > 0)
+        ret = (int)Pa_GetDeviceInfo(dev)->defaultSampleRate;
+    Pa_Terminate();
+    return ret;
+}
+
+/* Passing 0 as `srate` selects the device's native sample rate,
+ * and 0 as `buf_frames` enables auto-tuning of the buffer size.
+ * Audio files at other sample rates are resampled when loaded. */
+struct orion orion_create_ex(int srate, int nch,
+    int buf_frames, enum orion_latency lat_class)
+{
+    if (srate <= 0) srate = _orion_device_srate();
     struct orion ret = { 0 };
     ret.srate = srate;
     ret.nch = nch;
+    ret.buf_frames = buf_frames;
+    ret.lat_class = lat_class;
+    ret.cache_budget = ORION_CACHE_BUDGET;
+    ret.free_track = -1;
     return ret;
 }
 
-void orion_drop(struct orion *o)
+/* Decodes an entire Ogg Vorbis file, resampled to `dst_rate`;
+ * returns an error message or NULL */
+static const char *_orion_decode_ogg(const char *path, int dst_rate,
+    int *o_nch, int *o_len, orion_smp **o_pcm)
 {
-    SDL_AtomicLock(&o->lock);
-    int i;
-    for (i = 0; i < ORION_NUM_TRACKS; ++i)
-        if (o->track[i].pcm != NULL)
-            free(o->track[i].pcm);
-    SDL_AtomicUnlock(&o->lock);
-}
-
-const char *orion_load_ogg(struct orion *o, int tid, const char *path)
-{
-    /* Load the entire file with Ogg Vorbis */
     OggVorbis_File vf;
     int ret = ov_fopen(path, &vf);
     if (ret < 0) switch (ret) {
@@ -55,105 +80,968 @@ const char *orion_load_ogg(struct orion *o, int tid, const char *path)
     }
     ov_clear(&vf);
 
+    int len = buf_ptr / nch / sizeof(orion_smp);
+    if (srate != dst_rate) {
+        orion_smp *resampled;
+        len = orion_resample(srate, dst_rate, nch, len, (orion_smp *)buf, &resampled);
+        free(buf);
+        buf = (char *)resampled;
+    }
+
+    *o_nch = nch;
+    *o_len = len;
+    *o_pcm = (orion_smp *)buf;
+    return NULL;
+}
+
+static inline size_t _orion_pcm_bytes(const struct orion_pcm *p)
+{
+    if (p->adpcm != NULL) return p->adpcm_sz;
+    return (size_t)p->len * p->nch * sizeof(orion_smp);
+}
+
+static inline void _orion_pcm_free(struct orion_pcm *p)
+{
+    if (p->stretch != NULL) {
+        /* Stop the producer; it releases its own resources */
+        SDL_AtomicSet(&p->stretch->cancel, 1);
+        SDL_WaitThread(p->stretch->thread, NULL);
+        free(p->stretch);
+    }
+    free(p->path);
+    free(p->pcm);
+    free(p->adpcm);
+    free(p);
+}
+
+/* Wraps generated audio data; the result holds one reference
+ * and is not kept in the cache after being released */
+static struct orion_pcm *_orion_pcm_anon(struct orion *o,
+    int nch, int len, orion_smp *pcm)
+{
+    struct orion_pcm *p = (struct orion_pcm *)malloc(sizeof(struct orion_pcm));
+    p->path = NULL;
+    p->nch = nch;
+    p->len = len;
+    p->pcm = pcm;
+    p->adpcm = NULL;
+    p->adpcm_sz = 0;
+    SDL_AtomicSet(&p->ready, len);
+    p->stretch = NULL;
+    p->refs = 1;
+    p->next = NULL;
+    SDL_AtomicLock(&o->cache_lock);
+    o->pcm_bytes += _orion_pcm_bytes(p);
+    SDL_AtomicUnlock(&o->cache_lock);
+    return p;
+}
+
+/* The following functions should be called with the cache lock held */
+static struct orion_pcm *_orion_cache_find(struct orion *o, const char *path)
+{
+    struct orion_pcm *p;
+    for (p = o->cache; p != NULL; p = p->next)
+        if (strcmp(p->path, path) == 0) return p;
+    return NULL;
+}
+
+static inline void _orion_cache_ref(struct orion *o, struct orion_pcm *p)
+{
+    if (p->refs++ == 0 && p->path != NULL) o->cache_idle -= _orion_pcm_bytes(p);
+    p->last_use = ++o->cache_tick;
+}
+
+/* Unlinks least recently used entries until the budget is met;
+ * returns them as a list to be freed after unlocking */
+static struct orion_pcm *_orion_cache_trim(struct orion *o)
+{
+    struct orion_pcm *free_list = NULL, **pp, **lru;
+    while (o->cache_idle > o->cache_budget) {
+        lru = NULL;
+        for (pp = &o->cache; *pp != NULL; pp = &(*pp)->next)
+            if ((*pp)->refs == 0 && (lru == NULL || (*pp)->last_use < (*lru)->last_use))
+                lru = pp;
+        if (lru == NULL) break;
+        struct orion_pcm *p = *lru;
+        *lru = p->next;
+        o->cache_idle -= _orion_pcm_bytes(p);
+        o->pcm_bytes -= _orion_pcm_bytes(p);
+        p->next = free_list;
+        free_list = p;
+    }
+    return free_list;
+}
+
+static inline void _orion_pcm_free_list(struct orion_pcm *p)
+{
+    struct orion_pcm *next;
+    for (; p != NULL; p = next) {
+        next = p->next;
+        _orion_pcm_free(p);
+    }
+}
+
+static inline void _orion_pcm_ref(struct orion *o, struct orion_pcm *p)
+{
+    if (p == NULL) return;
+    SDL_AtomicLock(&o->cache_lock);
+    _orion_cache_ref(o, p);
+    SDL_AtomicUnlock(&o->cache_lock);
+}
+
+/* Drops a reference. Data decoded from files is kept while unreferenced
+ * as long as the cache budget allows; generated data is freed at once. */
+static void _orion_pcm_unref(struct orion *o, struct orion_pcm *p)
+{
+    if (p == NULL) return;
+    struct orion_pcm *free_list = NULL;
+    SDL_AtomicLock(&o->cache_lock);
+    if (--p->refs == 0) {
+        if (p->path == NULL) {
+            o->pcm_bytes -= _orion_pcm_bytes(p);
+            free_list = p;
+        } else {
+            o->cache_idle += _orion_pcm_bytes(p);
+            free_list = _orion_cache_trim(o);
+        }
+    }
+    SDL_AtomicUnlock(&o->cache_lock);
+    _orion_pcm_free_list(free_list);
+}
+
+/* Returns a new reference to the data of a file, decoding it only if it
+ * is not in the cache; returns NULL and sets `*err` on failure */
+static struct orion_pcm *_orion_cache_get(struct orion *o,
+    const char *path, const char **err)
+{
+    struct orion_pcm *p, *q;
+    SDL_AtomicLock(&o->cache_lock);
+    if ((p = _orion_cache_find(o, path)) != NULL) _orion_cache_ref(o, p);
+    SDL_AtomicUnlock(&o->cache_lock);
+    if (p != NULL) return p;
+
+    int nch, len;
+    orion_smp *pcm;
+    if ((*err = _orion_decode_ogg(path, o->srate, &nch, &len, &pcm)) != NULL) return NULL;
+    q = (struct orion_pcm *)malloc(sizeof(struct orion_pcm));
+    q->path = strdup(path);
+    q->nch = nch;
+    q->len = len;
+    q->pcm = pcm;
+    q->adpcm = NULL;
+    q->adpcm_sz = 0;
+    SDL_AtomicSet(&q->ready, len);
+    q->stretch = NULL;
+    q->refs = 1;
+
+    SDL_AtomicLock(&o->cache_lock);
+    /* The same file may have been loaded by another thread meanwhile */
+    if ((p = _orion_cache_find(o, path)) != NULL) {
+        _orion_cache_ref(o, p);
+    } else {
+        q->last_use = ++o->cache_tick;
+        q->next = o->cache;
+        o->cache = q;
+        o->pcm_bytes += _orion_pcm_bytes(q);
+    }
+    SDL_AtomicUnlock(&o->cache_lock);
+    if (p != NULL) {
+        _orion_pcm_free(q);
+        return p;
+    }
+    return q;
+}
+
+/* Sets the total size of unreferenced data to be kept in the cache */
+void orion_cache_budget(struct orion *o, size_t bytes)
+{
+    SDL_AtomicLock(&o->cache_lock);
+    o->cache_budget = bytes;
+    struct orion_pcm *free_list = _orion_cache_trim(o);
+    SDL_AtomicUnlock(&o->cache_lock);
+    _orion_pcm_free_list(free_list);
+}
+
+/* Returns the total size of audio data held, in bytes;
+ * the unreferenced part is stored in `*idle` if not NULL */
+size_t orion_cache_usage(struct orion *o, size_t *idle)
+{
+    SDL_AtomicLock(&o->cache_lock);
+    size_t ret = o->pcm_bytes;
+    if (idle != NULL) *idle = o->cache_idle;
+    SDL_AtomicUnlock(&o->cache_lock);
+    return ret;
+}
+
+/* Writers of published state hold the lock and write between these */
+static inline void _orion_clock_begin(struct orion *o)
+{
+    SDL_AtomicIncRef(&o->clock_seq);
+    SDL_MemoryBarrierRelease();
+}
+
+static inline void _orion_clock_end(struct orion *o)
+{
+    SDL_MemoryBarrierRelease();
+    SDL_AtomicIncRef(&o->clock_seq);
+}
+
+void orion_drop(struct orion *o)
+{
+    struct orion_track *chunks[ORION_MAX_TRACK_CHUNKS];
+    struct orion_pcm *data[ORION_NUM_SAMPLES];
+    int i, n;
+
+    /* Detach everything first, so that the callback stops at once */
+    SDL_AtomicLock(&o->lock);
+    n = o->n_tracks;
+    memcpy(chunks, o->track_chunk, sizeof chunks);
+    _orion_clock_begin(o);
+    memset(o->track_chunk, 0, sizeof o->track_chunk);
+    o->n_tracks = 0;
+    _orion_clock_end(o);
+    o->free_track = -1;
+    o->active_tracks = NULL;
+    for (i = 0; i < ORION_NUM_SAMPLES; ++i) {
+        data[i] = o->sample[i].data;
+        memset(&o->sample[i], 0, sizeof o->sample[i]);
+    }
+    o->n_active = 0;
+    struct orion_emitter *emitters = o->emitters;
+    o->emitters = NULL;
+    o->n_emitters = 0;
+    SDL_AtomicUnlock(&o->lock);
+    free(emitters);
+
+    for (i = 0; i < n; ++i)
+        _orion_pcm_unref(o, chunks[i / ORION_TRACK_CHUNK][i % ORION_TRACK_CHUNK].data);
+    for (i = 0; i < n / ORION_TRACK_CHUNK; ++i) free(chunks[i]);
+    for (i = 0; i < ORION_NUM_SAMPLES; ++i)
+        _orion_pcm_unref(o, data[i]);
+    orion_cache_budget(o, 0);
+    orion_set_backend(o, NULL, NULL);
+}
+
+/* The following functions should be called with the lock held */
+static inline struct orion_track *_orion_track_at(struct orion *o, int idx)
+{
+    return &o->track_chunk[idx / ORION_TRACK_CHUNK][idx % ORION_TRACK_CHUNK];
+}
+
+/* Returns the track referred to by a handle, or NULL if the handle is stale */
+static inline struct orion_track *_orion_track(struct orion *o, int tid)
+{
+    if (tid < 0 || (tid & TRACK_IDX_MASK) >= o->n_tracks) return NULL;
+    struct orion_track *t = _orion_track_at(o, tid & TRACK_IDX_MASK);
+    if (t->slot.state != ORION_SLOT_USED ||
+        t->slot.gen != tid >> ORION_TRACK_IDX_BITS) return NULL;
+    return t;
+}
+
+static inline void _orion_track_activate(struct orion *o, struct orion_track *t)
+{
+    if (t->slot.active) return;
+    t->slot.active = 1;
+    t->slot.prev = NULL;
+    t->slot.next = o->active_tracks;
+    if (o->active_tracks != NULL) o->active_tracks->slot.prev = t;
+    o->active_tracks = t;
+}
+
+static inline void _orion_track_deactivate(struct orion *o, struct orion_track *t)
+{
+    if (!t->slot.active) return;
+    if (t->slot.prev != NULL) t->slot.prev->slot.next = t->slot.next;
+    else o->active_tracks = t->slot.next;
+    if (t->slot.next != NULL) t->slot.next->slot.prev = t->slot.prev;
+    t->slot.active = 0;
+}
+
+/* Resets or copies the contents of a track,
+ * keeping its slot and published state */
+static inline void _orion_track_clear(struct orion_track *t)
+{
+    struct orion_track_slot slot = t->slot;
+    struct orion_track_clock pub = t->pub;
+    memset(t, 0, sizeof *t);
+    t->slot = slot;
+    t->pub = pub;
+}
+
+static inline void _orion_track_copy(struct orion_track *d, const struct orion_track *t)
+{
+    struct orion_track_slot slot = d->slot;
+    struct orion_track_clock pub = d->pub;
+    *d = *t;
+    d->slot = slot;
+    d->pub = pub;
+}
+
+static inline void _orion_track_stamp(struct orion_track *t)
+{
+    t->pub.tid = (t->slot.state == ORION_SLOT_USED ?
+        (t->slot.gen << ORION_TRACK_IDX_BITS) | t->slot.idx : -1);
+    t->pub.state = t->state;
+    t->pub.play_pos = t->play_pos;
+    t->pub.clock_pos = t->clock_pos;
+    t->pub.clock_ts = t->clock_ts;
+    t->pub.loop_start = t->loop_start;
+    t->pub.loop_end = t->loop_end;
+}
+
+/* Marks the current position as where the track is heard from `ts` on;
+ * outside the callback, that is the start of the next buffer */
+static inline void _orion_track_jump(struct orion_track *t, long ts)
+{
+    t->clock_pos = t->play_pos;
+    t->clock_ts = ts;
+}
+
+static void _orion_track_publish(struct orion *o, struct orion_track *t)
+{
+    _orion_clock_begin(o);
+    _orion_track_stamp(t);
+    _orion_clock_end(o);
+}
+
+/* Detaches the audio data from a track;
+ * returns the reference to be dropped after unlocking. */
+static struct orion_pcm *_orion_track_release(struct orion_track *t)
+{
+    struct orion_pcm *data = t->data;
+    t->pcm = NULL;
+    t->data = NULL;
+    t->state = ORION_UNINIT;
+    return data;
+}
+
+/* Puts a slot back into the free list; returns the reference to be dropped */
+static struct orion_pcm *_orion_track_free(struct orion *o, struct orion_track *t)
+{
+    struct orion_pcm *data = _orion_track_release(t);
+    _orion_track_deactivate(o, t);
+    _orion_track_clear(t);
+    t->slot.state = ORION_SLOT_FREE;
+    t->slot.next_free = o->free_track;
+    o->free_track = t->slot.idx;
+    return data;
+}
+
+/* Frees the slots of dropped tracks that have faded out; at most `max`
+ * references are stored in `data` to be dropped after unlocking.
+ * Returns the number of references stored. */
+static int _orion_track_reclaim(struct orion *o, struct orion_pcm **data, int max)
+{
+    int i, n = 0;
+    for (i = 0; i < o->n_tracks && n < max; ++i) {
+        struct orion_track *t = _orion_track_at(o, i);
+        if (t->slot.state == ORION_SLOT_DROPPING && t->state <= ORION_STOPPED)
+            data[n++] = _orion_track_free(o, t);
+    }
+    return n;
+}
+
+/* Allocates a track; returns its handle, or -1 if all slots are in use */
+int orion_track_create(struct orion *o)
+{
+    struct orion_track *chunk = NULL, *t;
+    struct orion_pcm *data[ORION_TRACK_CHUNK];
+    int ret = -1, n, i;
+
+    SDL_AtomicLock(&o->lock);
+    n = _orion_track_reclaim(o, data, ORION_TRACK_CHUNK);
+    while (o->free_track == -1) {
+        int c = o->n_tracks / ORION_TRACK_CHUNK;
+        if (c == ORION_MAX_TRACK_CHUNKS) goto unlock_ret;
+        if (chunk == NULL) {
+            /* Allocate outside the lock, then check again */
+            SDL_AtomicUnlock(&o->lock);
+            chunk = (struct orion_track *)calloc(ORION_TRACK_CHUNK, sizeof(struct orion_track));
+            SDL_AtomicLock(&o->lock);
+            continue;
+        }
+        for (i = ORION_TRACK_CHUNK - 1; i >= 0; --i) {
+            chunk[i].slot.idx = o->n_tracks + i;
+            chunk[i].slot.next_free = o->free_track;
+            chunk[i].pub.tid = -1;
+            o->free_track = o->n_tracks + i;
+        }
+        /* Lock-free readers look tracks up as well */
+        _orion_clock_begin(o);
+        o->track_chunk[c] = chunk;
+        o->n_tracks += ORION_TRACK_CHUNK;
+        _orion_clock_end(o);
+        chunk = NULL;
+    }
+    t = _orion_track_at(o, o->free_track);
+    o->free_track = t->slot.next_free;
+    t->slot.state = ORION_SLOT_USED;
+    _orion_track_publish(o, t);
+    ret = t->pub.tid;
+unlock_ret:
+    SDL_AtomicUnlock(&o->lock);
+    free(chunk);
+    for (i = 0; i < n; ++i) _orion_pcm_unref(o, data[i]);
+    return ret;
+}
+
+/* Releases a track after fading it out over `secs` seconds.
+ * The handle becomes invalid at once; the slot is reused after the fade. */
+void orion_track_drop(struct orion *o, int tid, float secs)
+{
+    struct orion_pcm *data = NULL;
+
+    SDL_AtomicLock(&o->lock);
+    struct orion_track *t = _orion_track(o, tid);
+    if (t == NULL) goto unlock_ret;
+    t->slot.gen = (t->slot.gen + 1) & TRACK_GEN_MASK;
+    t->sched_action = ORION_SCHED_NONE;
+    if (secs <= 0 || t->state <= ORION_STOPPED) {
+        data = _orion_track_free(o, t);
+    } else {
+        /* The callback stops the track once the ramp ends */
+        int smps = secs * o->srate;
+        t->slot.state = ORION_SLOT_DROPPING;
+        t->ramp_end = smps;
+        t->ramp_slope = -(double)t->volume / smps;
+    }
+    _orion_track_publish(o, t);
+unlock_ret:
+    SDL_AtomicUnlock(&o->lock);
+    _orion_pcm_unref(o, data);
+}
+
+/* Replaces the audio data of a track with a reference already taken;
+ * returns 0 and drops the reference if the handle is stale */
+static int _orion_track_set(struct orion *o, int tid, struct orion_pcm *data)
+{
+    struct orion_pcm *old;
     /* Store information into the track struct */
     SDL_AtomicLock(&o->lock);
-    /* In order to minimize the work done when holding the lock,
-     * we store the address and defer the memory deallocation */
-    orion_smp *free_ptr = o->track[tid].pcm;
-    memset(&o->track[tid], 0, sizeof o->track[tid]);
-    o->track[tid].nch = nch;
-    o->track[tid].len = buf_ptr / nch / sizeof(orion_smp);
-    o->track[tid].pcm = (orion_smp *)buf;
-    o->track[tid].state = ORION_STOPPED;
+    struct orion_track *t = _orion_track(o, tid);
+    if (t == NULL) {
+        old = data;
+    } else {
+        /* In order to minimize the work done when holding the lock,
+         * we store the reference and defer the release */
+        old = _orion_track_release(t);
+        _orion_track_clear(t);
+        t->nch = data->nch;
+        t->len = data->len;
+        t->pcm = data->pcm;
+        t->data = data;
+        t->state = ORION_STOPPED;
+        _orion_track_publish(o, t);
+    }
     SDL_AtomicUnlock(&o->lock);
-    if (free_ptr != NULL) free(free_ptr);
+    _orion_pcm_unref(o, old);
+    return t != NULL;
+}
+const char *orion_load_ogg(struct orion *o, int tid, const char *path)
+{
+    /* Load the entire file with Ogg Vorbis, unless cached */
+    const char *err;
+    struct orion_pcm *data = _orion_cache_get(o, path, &err);
+    if (data == NULL) return err;
+
+    if (!_orion_track_set(o, tid, data)) return "Invalid track handle";
 
     /* Finish with no errors */
     return NULL;
 }
 
+/* Loads audio data from memory; `pcm` is copied */
+void orion_load_raw(struct orion *o, int tid, int nch, int len, const orion_smp *pcm)
+{
+    orion_smp *buf = (orion_smp *)malloc(sizeof(orion_smp) * len * nch);
+    memcpy(buf, pcm, sizeof(orion_smp) * len * nch);
+    _orion_track_set(o, tid, _orion_pcm_anon(o, nch, len, buf));
+}
+
+/* Removes a voice from the active list; should be called with the lock held */
+static inline void _orion_voice_deactivate(struct orion *o, int vid)
+{
+    struct orion_voice *v = &o->voice[vid];
+    if (!v->playing) return;
+    v->playing = 0;
+    int last = o->active[--o->n_active];
+    o->active[v->active_idx] = last;
+    o->voice[last].active_idx = v->active_idx;
+}
+
+/* Replaces the audio data of a sample with a reference already taken */
+static void _orion_sample_set(struct orion *o, int sid, struct orion_pcm *data)
+{
+    SDL_AtomicLock(&o->lock);
+    struct orion_pcm *old = o->sample[sid].data;
+    if (old != data) {
+        /* Voices still playing the old data are stopped */
+        int i;
+        for (i = o->n_active - 1; i >= 0; --i)
+            if (o->voice[o->active[i]].sid == sid)
+                _orion_voice_deactivate(o, o->active[i]);
+        o->sample[sid].nch = data->nch;
+        o->sample[sid].len = data->len;
+        o->sample[sid].pcm = data->pcm;
+        o->sample[sid].data = data;
+    }
+    SDL_AtomicUnlock(&o->lock);
+    /* If the data is unchanged, the reference just taken is dropped */
+    _orion_pcm_unref(o, old);
+}
+
+const char *orion_load_sample(struct orion *o, int sid, const char *path)
+{
+    const char *err;
+    struct orion_pcm *data = _orion_cache_get(o, path, &err);
+    if (data == NULL) return err;
+    if (data->pcm == NULL) {
+        _orion_pcm_unref(o, data);
+        return "Compressed audio data cannot be used as a sample";
+    }
+    _orion_sample_set(o, sid, data);
+    return NULL;
+}
+
+/* Loads sample data from memory; `pcm` is copied */
+void orion_load_sample_raw(struct orion *o, int sid, int nch, int len, const orion_smp *pcm)
+{
+    orion_smp *buf = (orion_smp *)malloc(sizeof(orion_smp) * len * nch);
+    memcpy(buf, pcm, sizeof(orion_smp) * len * nch);
+    _orion_sample_set(o, sid, _orion_pcm_anon(o, nch, len, buf));
+}
+
+/* Sets the volume applied to all voices of a sample */
+void orion_sample_volume(struct orion *o, int sid, float vol)
+{
+    SDL_AtomicLock(&o->lock);
+    o->sample[sid].volume = vol;
+    SDL_AtomicUnlock(&o->lock);
+}
+
+void orion_voice_policy(struct orion *o, enum orion_steal policy)
+{
+    SDL_AtomicLock(&o->lock);
+    o->steal = policy;
+    SDL_AtomicUnlock(&o->lock);
+}
+
+/* Starts a new voice of a sample at timestamp `at`; past timestamps
+ * start it with the next buffer. Returns a handle for the voice,
+ * or -1 if the sample is not loaded or no voice can be taken. */
+int orion_voice_play_at(struct orion *o, int sid, long at)
+{
+    int ret = -1, i, vid = -1;
+
+    SDL_AtomicLock(&o->lock);
+    if (o->sample[sid].pcm == NULL) goto unlock_ret;
+    if (o->n_active < ORION_NUM_VOICES) {
+        for (i = 0; i < ORION_NUM_VOICES; ++i)
+            if (!o->voice[i].playing) { vid = i; break; }
+    } else if (o->steal == ORION_STEAL_OLDEST) {
+        vid = 0;
+        for (i = 1; i < ORION_NUM_VOICES; ++i)
+            if (o->voice[i].start < o->voice[vid].start) vid = i;
+    } else if (o->steal == ORION_STEAL_QUIETEST) {
+        float min_vol = 1e10, vol;
+        for (i = 0; i < ORION_NUM_VOICES; ++i) {
+            vol = o->voice[i].volume * o->sample[o->voice[i].sid].volume;
+            if (vol < min_vol) { min_vol = vol; vid = i; }
+        }
+    }
+    if (vid == -1) goto unlock_ret;
+
+    _orion_voice_deactivate(o, vid);
+    struct orion_voice *v = &o->voice[vid];
+    v->sid = sid;
+    v->play_pos = 0;
+    v->volume = 1;
+    v->ramp_end = 0;
+    v->ramp_slope = 0;
+    v->start = (at > o->timestamp) ? at : o->timestamp;
+    v->playing = 1;
+    v->active_idx = o->n_active;
+    o->active[o->n_active++] = vid;
+    ret = (++v->gen) * ORION_NUM_VOICES + vid;
+unlock_ret:
+    SDL_AtomicUnlock(&o->lock);
+    return ret;
+}
+
+int orion_voice_play(struct orion *o, int sid)
+{
+    return orion_voice_play_at(o, sid, 0);
+}
+
+/* Looks up a voice handle; should be called with the lock held */
+static inline struct orion_voice *_orion_voice_get(struct orion *o, int handle)
+{
+    if (handle < 0) return NULL;
+    struct orion_voice *v = &o->voice[handle % ORION_NUM_VOICES];
+    if (!v->playing || v->gen != handle / ORION_NUM_VOICES) return NULL;
+    return v;
+}
+
+void orion_voice_stop(struct orion *o, int handle)
+{
+    SDL_AtomicLock(&o->lock);
+    if (_orion_voice_get(o, handle) != NULL)
+        _orion_voice_deactivate(o, handle % ORION_NUM_VOICES);
+    SDL_AtomicUnlock(&o->lock);
+}
+
+void orion_voice_ramp(struct orion *o, int handle, float secs, float dst)
+{
+    SDL_AtomicLock(&o->lock);
+    struct orion_voice *v = _orion_voice_get(o, handle);
+    if (v == NULL) goto unlock_ret;
+    if (secs <= 0) {
+        v->volume = dst;
+        v->ramp_slope = 0;
+    } else {
+        int smps = secs * o->srate;
+        v->ramp_end = smps;
+        v->ramp_slope = (double)(dst - v->volume) / smps;
+    }
+unlock_ret:
+    SDL_AtomicUnlock(&o->lock);
+}
+
+/* Waits until audio data is fully produced */
+static void _orion_pcm_wait(struct orion_pcm *p)
+{
+    while (SDL_AtomicGet(&p->ready) < p->len) SDL_Delay(1);
+    SDL_MemoryBarrierAcquire();
+}
+
+void orion_wait(struct orion *o, int tid)
+{
+    SDL_AtomicLock(&o->lock);
+    struct orion_track *t = _orion_track(o, tid);
+    struct orion_pcm *data = (t != NULL ? t->data : NULL);
+    _orion_pcm_ref(o, data);
+    SDL_AtomicUnlock(&o->lock);
+    if (data == NULL) return;
+    _orion_pcm_wait(data);
+    _orion_pcm_unref(o, data);
+}
+
+/* Returns the raw samples of audio data, decoding them if compressed;
+ * the result should be freed if it differs from `p->pcm` */
+static orion_smp *_orion_pcm_raw(struct orion_pcm *p)
+{
+    _orion_pcm_wait(p);
+    if (p->pcm != NULL) return p->pcm;
+    orion_smp *buf = (orion_smp *)malloc(sizeof(orion_smp) * p->len * p->nch);
+    orion_adpcm_decode(p->nch, p->len, p->adpcm, buf);
+    return buf;
+}
+
 void orion_apply_lowpass(struct orion *o, int tid, int did, double cutoff)
 {
     char *buf;
-    orion_smp *free_ptr = NULL;
+    struct orion_pcm *src = NULL, *old = NULL;
+    struct orion_track *t, *d;
 
     SDL_AtomicLock(&o->lock);
-    if (o->track[tid].state < ORION_STOPPED) goto unlock_ret;
+    t = _orion_track(o, tid);
+    if (t == NULL || t->state < ORION_STOPPED) goto unlock_ret;
     int srate = o->srate;
-    int nch = o->track[tid].nch;
-    int orig_len = o->track[tid].len * o->track[tid].nch;
-    char *orig_buf = (char *)o->track[tid].pcm;
+    int nch = t->nch;
+    int len = t->len;
+    /* Keep the source alive while unlocked */
+    src = t->data;
+    _orion_pcm_ref(o, src);
     SDL_AtomicUnlock(&o->lock);
 
-    iir_lowpass(srate, cutoff, nch, orig_len, orig_buf, &buf);
+    orion_smp *raw = _orion_pcm_raw(src);
+    iir_lowpass(srate, cutoff, nch, len * nch, (char *)raw, &buf);
+    if (raw != src->pcm) free(raw);
+    struct orion_pcm *data = _orion_pcm_anon(o, nch, len, (orion_smp *)buf);
 
     SDL_AtomicLock(&o->lock);
-    free_ptr = o->track[did].pcm;
-    o->track[did] = o->track[tid];
-    o->track[did].pcm = (orion_smp *)buf;
-    o->track[did].state = ORION_STOPPED;
+    /* Either track may have been dropped meanwhile */
+    t = _orion_track(o, tid);
+    d = _orion_track(o, did);
+    if (t == NULL || d == NULL) {
+        old = data;
+        goto unlock_ret;
+    }
+    old = _orion_track_release(d);
+    _orion_track_copy(d, t);
+    d->pcm = data->pcm;
+    d->data = data;
+    d->blk_end = 0;
+    d->state = ORION_STOPPED;
+    _orion_track_publish(o, d);
 unlock_ret:
     SDL_AtomicUnlock(&o->lock);
-    if (free_ptr != NULL) free(free_ptr);
+    _orion_pcm_unref(o, old);
+    _orion_pcm_unref(o, src);
 }
 
-void orion_apply_stretch(struct orion *o, int tid, int did, double delta_pc)
+/* Produces stretched samples until at least `target` are available */
+static void _orion_stretch_run(struct orion_pcm *p, int target)
 {
-    int len;
-    char *buf;
-    orion_smp *free_ptr = NULL;
+    struct orion_stretch *s = p->stretch;
+    int nch = p->nch, in_len = s->src->len;
+    int out_pos = SDL_AtomicGet(&p->ready);
+    if (target > p->len) target = p->len;
+    while (out_pos < target && !SDL_AtomicGet(&s->cancel)) {
+        int n = in_len - s->in_pos;
+        if (n > ORION_STRETCH_CHUNK) n = ORION_STRETCH_CHUNK;
+        int last = (s->in_pos + n == in_len);
+        out_pos += st_stream_process(s->st, n * nch,
+            (const char *)(s->raw + (size_t)s->in_pos * nch), last,
+            (p->len - out_pos) * nch, (char *)(p->pcm + (size_t)out_pos * nch)) / nch;
+        s->in_pos += n;
+        /* The output may fall short of the estimated length */
+        if (last) {
+            memset(p->pcm + (size_t)out_pos * nch, 0,
+                sizeof(orion_smp) * (p->len - out_pos) * nch);
+            out_pos = p->len;
+        }
+        /* Publish the samples before the count */
+        SDL_MemoryBarrierRelease();
+        SDL_AtomicSet(&p->ready, out_pos);
+    }
+}
+
+static void _orion_stretch_end(struct orion_pcm *p)
+{
+    struct orion_stretch *s = p->stretch;
+    st_stream_drop(s->st);
+    if (s->raw != s->src->pcm) free(s->raw);
+    _orion_pcm_unref(s->o, s->src);
+}
+
+static int _orion_stretch_routine(void *_p)
+{
+    struct orion_pcm *p = (struct orion_pcm *)_p;
+    SDL_SetThreadPriority(SDL_THREAD_PRIORITY_LOW);
+    _orion_stretch_run(p, p->len);
+    _orion_stretch_end(p);
+    return 0;
+}
+
+void orion_apply_stretch_lazy(struct orion *o, int tid, int did, double delta_pc, int sync_len)
+{
+    struct orion_pcm *src = NULL, *old = NULL;
+    struct orion_track *t, *d;
 
     SDL_AtomicLock(&o->lock);
-    if (o->track[tid].state < ORION_STOPPED) goto unlock_ret;
+    t = _orion_track(o, tid);
+    if (t == NULL || t->state < ORION_STOPPED) goto unlock_ret;
     int srate = o->srate;
-    int nch = o->track[tid].nch;
-    int orig_len = o->track[tid].len * o->track[tid].nch;
-    char *orig_buf = (char *)o->track[tid].pcm;
+    int nch = t->nch;
+    src = t->data;
+    _orion_pcm_ref(o, src);
     SDL_AtomicUnlock(&o->lock);
 
-    st_change_tempo(srate, delta_pc, nch, orig_len, orig_buf, &len, &buf);
+    struct orion_stretch *s = (struct orion_stretch *)malloc(sizeof(struct orion_stretch));
+    s->o = o;
+    s->st = st_stream_create(srate, delta_pc, nch);
+    s->src = src;
+    s->raw = _orion_pcm_raw(src);
+    s->in_pos = 0;
+    SDL_AtomicSet(&s->cancel, 0);
+    s->thread = NULL;
+    /* The reference is released by the producer */
+    src = NULL;
+
+    int len = (int)(s->src->len * st_stream_ratio(s->st));
+    orion_smp *buf = (orion_smp *)malloc(sizeof(orion_smp) * len * nch);
+    struct orion_pcm *data = _orion_pcm_anon(o, nch, len, buf);
+    SDL_AtomicSet(&data->ready, 0);
+    data->stretch = s;
+    _orion_stretch_run(data, sync_len);
+    if (SDL_AtomicGet(&data->ready) < len)
+        s->thread = SDL_CreateThread(_orion_stretch_routine, "Orion stretch", data);
+    if (s->thread == NULL) {
+        /* Either finished, or the rest has to be done here */
+        _orion_stretch_run(data, len);
+        _orion_stretch_end(data);
+        data->stretch = NULL;
+        free(s);
+    }
 
     SDL_AtomicLock(&o->lock);
-    free_ptr = o->track[did].pcm;
-    o->track[did] = o->track[tid];
-    o->track[did].len = len / o->track[tid].nch;
-    o->track[did].pcm = (orion_smp *)buf;
-    o->track[did].state = ORION_STOPPED;
+    t = _orion_track(o, tid);
+    d = _orion_track(o, did);
+    if (t == NULL || d == NULL) {
+        old = data;
+        goto unlock_ret;
+    }
+    old = _orion_track_release(d);
+    _orion_track_copy(d, t);
+    d->len = data->len;
+    d->pcm = data->pcm;
+    d->data = data;
+    d->blk_end = 0;
+    d->state = ORION_STOPPED;
+    _orion_track_publish(o, d);
 unlock_ret:
     SDL_AtomicUnlock(&o->lock);
-    if (free_ptr != NULL) free(free_ptr);
+    _orion_pcm_unref(o, old);
+    _orion_pcm_unref(o, src);
 }
 
-void orion_play_once(struct orion *o, int tid)
+void orion_apply_stretch(struct orion *o, int tid, int did, double delta_pc)
 {
+    orion_apply_stretch_lazy(o, tid, did, delta_pc, INT_MAX);
+}
+
+/* Makes track `did` play the audio data of track `tid` without copying it */
+void orion_share(struct orion *o, int tid, int did)
+{
+    struct orion_pcm *old = NULL;
+
     SDL_AtomicLock(&o->lock);
-    if (o->track[tid].state < ORION_STOPPED) goto unlock_ret;
-    o->track[tid].play_pos = 0;
-    o->track[tid].loop_start = -1;
-    o->track[tid].loop_end = o->track[tid].len;
-    o->track[tid].ramp_slope = 0;
-    o->track[tid].state = ORION_ONCE;
+    struct orion_track *t = _orion_track(o, tid), *d = _orion_track(o, did);
+    if (t == NULL || d == NULL || t->state < ORION_STOPPED) goto unlock_ret;
+    if (t->data == d->data) goto unlock_ret;
+    old = _orion_track_release(d);
+    _orion_track_clear(d);
+    d->nch = t->nch;
+    d->len = t->len;
+    d->pcm = t->pcm;
+    d->data = t->data;
+    _orion_pcm_ref(o, d->data);
+    d->state = ORION_STOPPED;
+    _orion_track_publish(o, d);
 unlock_ret:
     SDL_AtomicUnlock(&o->lock);
+    _orion_pcm_unref(o, old);
+}
+
+/* Replaces the audio data of a track, and of all tracks sharing it, with an
+ * IMA-ADPCM encoded copy of about a quarter the size. Decoding happens in the
+ * callback one block at a time. Samples keep using the raw data. */
+void orion_compress(struct orion *o, int tid)
+{
+    struct orion_pcm *src = NULL, *data;
+    int i, refs = 0;
+
+    SDL_AtomicLock(&o->lock);
+    struct orion_track *t = _orion_track(o, tid);
+    if (t == NULL || t->state < ORION_STOPPED) goto unlock_ret;
+    if (t->pcm == NULL || t->nch > ORION_ADPCM_MAXCH) goto unlock_ret;
+    src = t->data;
+    _orion_pcm_ref(o, src);
+    SDL_AtomicUnlock(&o->lock);
+
+    _orion_pcm_wait(src);
+    data = (struct orion_pcm *)malloc(sizeof(struct orion_pcm));
+    data->path = NULL;
+    data->nch = src->nch;
+    data->len = src->len;
+    data->pcm = NULL;
+    data->adpcm_sz = orion_adpcm_size(src->nch, src->len);
+    data->adpcm = (unsigned char *)malloc(data->adpcm_sz);
+    SDL_AtomicSet(&data->ready, data->len);
+    data->stretch = NULL;
+    data->refs = 0;
+    data->next = NULL;
+    orion_adpcm_encode(src->nch, src->len, src->pcm, data->adpcm);
+
+    SDL_AtomicLock(&o->lock);
+    for (i = 0; i < o->n_tracks; ++i) {
+        t = _orion_track_at(o, i);
+        if (t->data == src) {
+            t->pcm = NULL;
+            t->data = data;
+            t->blk_end = 0;
+            ++refs;
+        }
+    }
+    if (refs > 0) {
+        SDL_AtomicLock(&o->cache_lock);
+        data->refs = refs;
+        o->pcm_bytes += _orion_pcm_bytes(data);
+        /* Take over the cache entry, so that the file is not decoded
+         * again and the raw data is freed when no longer used */
+        if (src->path != NULL) {
+            struct orion_pcm **pp = &o->cache;
+            while (*pp != src) pp = &(*pp)->next;
+            *pp = src->next;
+            src->next = NULL;
+            data->path = src->path;
+            src->path = NULL;
+            data->last_use = ++o->cache_tick;
+            data->next = o->cache;
+            o->cache = data;
+        }
+        SDL_AtomicUnlock(&o->cache_lock);
+    }
+    SDL_AtomicUnlock(&o->lock);
+
+    if (refs == 0) _orion_pcm_free(data);
+    /* Drop the references held by the tracks, and the one taken above */
+    for (i = 0; i <= refs; ++i) _orion_pcm_unref(o, src);
+    return;
+
+unlock_ret:
+    SDL_AtomicUnlock(&o->lock);
+}
+
+/* The following functions should be called with the lock held */
+static inline void _orion_track_once(struct orion *o, struct orion_track *t)
+{
+    if (t->state < ORION_STOPPED) return;
+    t->play_pos = 0;
+    t->loop_start = -1;
+    t->loop_end = t->len;
+    t->ramp_slope = 0;
+    t->state = ORION_ONCE;
+    _orion_track_activate(o, t);
+}
+
+static inline void _orion_track_pause(struct orion_track *t)
+{
+    if (t->state <= ORION_STOPPED) return;
+    t->state = ORION_STOPPED;
+}
+
+static inline void _orion_track_resume(struct orion *o, struct orion_track *t)
+{
+    if (t->state != ORION_STOPPED) return;
+    t->state = (t->loop_start == -1) ? ORION_ONCE : ORION_LOOP;
+    _orion_track_activate(o, t);
+}
+
+void orion_play_once(struct orion *o, int tid)
+{
+    SDL_AtomicLock(&o->lock);
+    struct orion_track *t = _orion_track(o, tid);
+    if (t != NULL) {
+        _orion_track_once(o, t);
+        _orion_track_jump(t, o->timestamp);
+        _orion_track_publish(o, t);
+    }
+    SDL_AtomicUnlock(&o->lock);
 }
 
 void orion_play_loop(struct orion *o, int tid, int intro_pos, int start_pos, int end_pos)
 {
     SDL_AtomicLock(&o->lock);
-    if (o->track[tid].state != ORION_STOPPED) goto unlock_ret;
-    o->track[tid].play_pos = intro_pos;
-    int l = o->track[tid].len;
+    struct orion_track *t = _orion_track(o, tid);
+    if (t == NULL || t->state != ORION_STOPPED) goto unlock_ret;
+    t->play_pos = intro_pos;
+    int l = t->len;
     start_pos = ((start_pos % l) + l) % l;
     end_pos = ((end_pos % l) + l) % l;
     if (end_pos < start_pos) {
-        int t = end_pos;
+        int tmp = end_pos;
         end_pos = start_pos;
-        start_pos = t;
+        start_pos = tmp;
     }
-    o->track[tid].loop_start = start_pos;
-    o->track[tid].loop_end = end_pos;
-    o->track[tid].ramp_slope = 0;
-    o->track[tid].state = ORION_LOOP;
+    t->loop_start = start_pos;
+    t->loop_end = end_pos;
+    t->ramp_slope = 0;
+    t->state = ORION_LOOP;
+    _orion_track_activate(o, t);
+    _orion_track_jump(t, o->timestamp);
+    _orion_track_publish(o, t);
 unlock_ret:
     SDL_AtomicUnlock(&o->lock);
 }
@@ -161,79 +1049,345 @@ unlock_ret:
 void orion_pause(struct orion *o, int tid)
 {
     SDL_AtomicLock(&o->lock);
-    if (o->track[tid].state <= ORION_STOPPED) goto unlock_ret;
-    o->track[tid].state = ORION_STOPPED;
-unlock_ret:
+    struct orion_track *t = _orion_track(o, tid);
+    if (t != NULL) {
+        _orion_track_pause(t);
+        _orion_track_jump(t, o->timestamp);
+        _orion_track_publish(o, t);
+    }
     SDL_AtomicUnlock(&o->lock);
 }
 
 void orion_resume(struct orion *o, int tid)
 {
     SDL_AtomicLock(&o->lock);
-    if (o->track[tid].state != ORION_STOPPED) goto unlock_ret;
-    o->track[tid].state =
-        (o->track[tid].loop_start == -1) ? ORION_ONCE : ORION_LOOP;
-unlock_ret:
+    struct orion_track *t = _orion_track(o, tid);
+    if (t != NULL) {
+        _orion_track_resume(o, t);
+        _orion_track_jump(t, o->timestamp);
+        _orion_track_publish(o, t);
+    }
+    SDL_AtomicUnlock(&o->lock);
+}
+
+/* Performs an action on a group of tracks at timestamp `at`, so that they
+ * stay sample-aligned. Timestamps already passed take effect with the
+ * next buffer. A later call replaces the pending action on a track. */
+void orion_schedule(struct orion *o, const int *tids, int n,
+    long at, enum orion_sched_action action)
+{
+    SDL_AtomicLock(&o->lock);
+    int i;
+    for (i = 0; i < n; ++i) {
+        struct orion_track *t = _orion_track(o, tids[i]);
+        if (t == NULL) continue;
+        t->sched_action = action;
+        t->sched_at = at;
+        _orion_track_activate(o, t);
+    }
     SDL_AtomicUnlock(&o->lock);
 }
 
 void orion_seek(struct orion *o, int tid, int pos)
 {
     SDL_AtomicLock(&o->lock);
-    if (o->track[tid].state <= ORION_STOPPED) goto unlock_ret;
+    struct orion_track *t = _orion_track(o, tid);
+    if (t == NULL || t->state < ORION_STOPPED) goto unlock_ret;
     /* Past-the-end positions will be fixed at next playback frame */
-    int l = o->track[tid].len;
+    int l = t->len;
     pos = ((pos % l) + l) % l;
-    o->track[tid].play_pos = pos;
+    t->play_pos = pos;
+    _orion_track_jump(t, o->timestamp);
+    _orion_track_publish(o, t);
 unlock_ret:
     SDL_AtomicUnlock(&o->lock);
 }
 
+/* Reads the published state of a track without locking;
+ * returns 0 if the handle is stale */
+static int _orion_clock_read(struct orion *o, int tid,
+    struct orion_track_clock *c, double *heard_at, long *heard_ts)
+{
+    int seq, found, idx = tid & TRACK_IDX_MASK;
+    do {
+        while ((seq = SDL_AtomicGet(&o->clock_seq)) & 1) ;
+        SDL_MemoryBarrierAcquire();
+        struct orion_track *chunk = (tid >= 0 && idx < o->n_tracks) ?
+            o->track_chunk[idx / ORION_TRACK_CHUNK] : NULL;
+        found = (chunk != NULL && chunk[idx % ORION_TRACK_CHUNK].pub.tid == tid);
+        if (found) *c = chunk[idx % ORION_TRACK_CHUNK].pub;
+        *heard_at = o->heard_at;
+        *heard_ts = o->heard_ts;
+        SDL_MemoryBarrierAcquire();
+    } while (SDL_AtomicGet(&o->clock_seq) != seq);
+    return found;
+}
+
+/* The following queries never wait for the callback */
 int orion_tell(struct orion *o, int tid)
 {
-    SDL_AtomicLock(&o->lock);
-    int ret;
-    if (o->track[tid].state == ORION_UNINIT) ret = -1;
-    else ret = o->track[tid].play_pos;
-    SDL_AtomicUnlock(&o->lock);
+    struct orion_track_clock c;
+    double heard_at;
+    long heard_ts;
+    if (!_orion_clock_read(o, tid, &c, &heard_at, &heard_ts) || c.state == ORION_UNINIT)
+        return -1;
+    return c.play_pos;
+}
+
+/* Returns the position being heard at the moment, interpolated from the
+ * timing of the last buffer and compensated for output latency;
+ * falls back to `orion_tell()` if the stream does not provide timing */
+double orion_tell_precise(struct orion *o, int tid)
+{
+    struct orion_track_clock c;
+    double heard_at, ret;
+    long heard_ts;
+    if (!_orion_clock_read(o, tid, &c, &heard_at, &heard_ts) || c.state == ORION_UNINIT) {
+        ret = -1;
+    } else if (c.state == ORION_STOPPED || heard_at <= 0) {
+        ret = c.play_pos;
+    } else {
+        double now = (double)SDL_GetPerformanceCounter() / SDL_GetPerformanceFrequency();
+        /* The track stays at `clock_pos` until `clock_ts` is heard */
+        double elapsed = (now - heard_at) * o->srate - (c.clock_ts - heard_ts);
+        ret = c.clock_pos + (elapsed > 0 ? elapsed : 0);
+        /* Positions slightly before the last buffer are not wrapped back,
+         * since they are a whole number of loops away from the real one */
+        if (ret >= c.loop_end) {
+            if (c.state == ORION_ONCE) {
+                ret = c.loop_end;
+            } else {
+                int l = c.loop_end - c.loop_start;
+                ret = c.loop_start + fmod(ret - c.loop_end, l);
+            }
+        }
+    }
     return ret;
 }
 
+/* Should be called with the lock held */
+static void _orion_track_ramp(struct orion *o, struct orion_track *t, float secs, float dst)
+{
+    if (secs <= 0) {
+        t->volume = dst;
+    } else {
+        int smps = secs * o->srate;
+        float cur_vol = t->volume;
+        t->ramp_end = smps;
+        t->ramp_slope = (double)(dst - cur_vol) / smps;
+    }
+}
+
 void orion_ramp(struct orion *o, int tid, float secs, float dst)
 {
     SDL_AtomicLock(&o->lock);
-    if (o->track[tid].state <= ORION_STOPPED && secs > 0) goto unlock_ret;
+    struct orion_track *t = _orion_track(o, tid);
+    if (t == NULL || (t->state <= ORION_STOPPED && secs > 0)) goto unlock_ret;
+    _orion_track_ramp(o, t, secs, dst);
+unlock_ret:
+    SDL_AtomicUnlock(&o->lock);
+}
+
+void orion_try_ramp(struct orion *o, int tid, float secs, float dst)
+{
+    SDL_AtomicLock(&o->lock);
+    struct orion_track *t = _orion_track(o, tid);
+    if (t != NULL && t->state > ORION_STOPPED && t->ramp_slope == 0)
+        _orion_track_ramp(o, t, secs, dst);
+    SDL_AtomicUnlock(&o->lock);
+}
+
+/* Rounds half away from zero, so that negative samples are not biased */
+static inline orion_smp _orion_round(float x)
+{
+    return (orion_smp)(x >= 0 ? x + 0.5f : x - 0.5f);
+}
+
+static void _orion_filter_design(struct orion_filter *f, int srate)
+{
+    int k;
+    for (k = 0; k < ORION_BUTTERWORTH_SECTIONS; ++k)
+        orion_biquad_lowpass(&f->sec[k], srate, f->cutoff, ORION_BUTTERWORTH_Q[k]);
+}
+
+static inline double _orion_filter_clamp(double cutoff, int srate)
+{
+    if (cutoff < 1) return 1;
+    if (cutoff > srate * 0.49) return srate * 0.49;
+    return cutoff;
+}
+
+void orion_filter_lowpass(struct orion *o, int tid, float secs, double cutoff)
+{
+    SDL_AtomicLock(&o->lock);
+    struct orion_track *t = _orion_track(o, tid);
+    if (t == NULL || t->state == ORION_UNINIT) goto unlock_ret;
+    struct orion_filter *f = &t->filter;
+    cutoff = _orion_filter_clamp(cutoff, o->srate);
+    if (!f->enabled) {
+        /* Newly inserted filters start fully wet with no sweep */
+        memset(f, 0, sizeof *f);
+        f->enabled = 1;
+        f->mix = 1;
+        secs = 0;
+    }
     if (secs <= 0) {
-        o->track[tid].volume = dst;
+        f->cutoff = f->cutoff_dst = cutoff;
+        f->cutoff_end = 0;
+        _orion_filter_design(f, o->srate);
     } else {
         int smps = secs * o->srate;
-        float cur_vol = o->track[tid].volume;
-        o->track[tid].ramp_end = smps;
-        o->track[tid].ramp_slope = (double)(dst - cur_vol) / smps;
+        f->cutoff_dst = cutoff;
+        f->cutoff_end = smps;
+        f->cutoff_mul = pow(cutoff / f->cutoff, 1.0 / smps);
     }
 unlock_ret:
     SDL_AtomicUnlock(&o->lock);
 }
 
-void orion_try_ramp(struct orion *o, int tid, float secs, float dst)
+void orion_filter_mix(struct orion *o, int tid, float secs, float dst)
 {
     SDL_AtomicLock(&o->lock);
-    if (o->track[tid].state <= ORION_STOPPED || o->track[tid].ramp_slope != 0) {
-        SDL_AtomicUnlock(&o->lock);
+    struct orion_track *t = _orion_track(o, tid);
+    if (t == NULL || !t->filter.enabled) goto unlock_ret;
+    struct orion_filter *f = &t->filter;
+    if (secs <= 0) {
+        f->mix = dst;
+        f->mix_slope = 0;
     } else {
-        SDL_AtomicUnlock(&o->lock);
-        orion_ramp(o, tid, secs, dst);
+        int smps = secs * o->srate;
+        f->mix_end = smps;
+        f->mix_slope = (double)(dst - f->mix) / smps;
     }
+unlock_ret:
+    SDL_AtomicUnlock(&o->lock);
 }
 
-static void _orion_track_step(struct orion_track *t, orion_smp *buf, int nch, int nsmp)
+/* Makes a track positional or not; a positional track is silent
+ * until it gets emitters. Loading new data makes it non-positional. */
+void orion_spatial_track(struct orion *o, int tid, int on)
 {
-    if (t->state <= ORION_STOPPED) return;
-    int i, j;
+    SDL_AtomicLock(&o->lock);
+    struct orion_track *t = _orion_track(o, tid);
+    if (t != NULL && t->spatial != !!on) {
+        t->spatial = !!on;
+        t->sp_gain = t->sp_dst = t->sp_slope = 0;
+    }
+    SDL_AtomicUnlock(&o->lock);
+}
+
+/* Sets the emitters of all positional tracks, replacing the previous ones.
+ * A track can have several emitters; positional tracks without any
+ * fade out, and emitters of other tracks are ignored. */
+void orion_spatial_emitters(struct orion *o, const struct orion_emitter *emitters, int n)
+{
+    struct orion_emitter *buf = NULL, *old;
+    if (n > 0) {
+        buf = (struct orion_emitter *)malloc(sizeof(struct orion_emitter) * n);
+        memcpy(buf, emitters, sizeof(struct orion_emitter) * n);
+    }
+
+    SDL_AtomicLock(&o->lock);
+    old = o->emitters;
+    o->emitters = buf;
+    o->n_emitters = n;
+    SDL_AtomicUnlock(&o->lock);
+    free(old);
+}
+
+/* Moves the listener and sets the gain shared by all positional tracks.
+ * Does not take the lock, but should only be called from one thread. */
+void orion_spatial_listener(struct orion *o, float x, float y, float gain)
+{
+    SDL_AtomicIncRef(&o->listener_seq);
+    SDL_MemoryBarrierRelease();
+    o->listener.x = x;
+    o->listener.y = y;
+    o->listener.gain = gain;
+    SDL_MemoryBarrierRelease();
+    SDL_AtomicIncRef(&o->listener_seq);
+}
+
+/* Never waits: if the listener is being written, the last consistent
+ * copy is used for one more buffer. Called from the audio thread only */
+static void _orion_spatial_read(struct orion *o, struct orion_listener *l)
+{
+    int seq = SDL_AtomicGet(&o->listener_seq);
+    if (!(seq & 1)) {
+        SDL_MemoryBarrierAcquire();
+        struct orion_listener cur = o->listener;
+        SDL_MemoryBarrierAcquire();
+        if (SDL_AtomicGet(&o->listener_seq) == seq) o->listener_last = cur;
+    }
+    *l = o->listener_last;
+}
+
+/* Computes the gain of positional tracks over the next buffer, from their
+ * share of the total inverse distance to the listener.
+ * Should be called with the lock held. */
+static void _orion_spatial_update(struct orion *o, int nframes)
+{
+    struct orion_listener l;
+    struct orion_track *t;
+    float sum = 0;
+    int i;
+    _orion_spatial_read(o, &l);
+
+    for (i = 0; i < o->n_emitters; ++i)
+        if ((t = _orion_track(o, o->emitters[i].tid)) != NULL) t->sp_weight = 0;
+    for (t = o->active_tracks; t != NULL; t = t->slot.next) t->sp_weight = 0;
+    for (i = 0; i < o->n_emitters; ++i) {
+        t = _orion_track(o, o->emitters[i].tid);
+        if (t == NULL || !t->spatial) continue;
+        float d = hypotf(o->emitters[i].x - l.x, o->emitters[i].y - l.y);
+        float w = 1 / (d > 1e-3f ? d : 1e-3f);
+        t->sp_weight += w;
+        sum += w;
+    }
+    /* Approach the target exponentially, linearly within a buffer */
+    float k = 1 - expf(-nframes / (ORION_SPATIAL_SMOOTH * o->srate));
+    for (t = o->active_tracks; t != NULL; t = t->slot.next) {
+        if (!t->spatial) continue;
+        float dst = (sum > 0 ? t->sp_weight / sum * l.gain : 0);
+        if (t->state <= ORION_STOPPED) {
+            t->sp_gain = t->sp_dst = dst;
+            t->sp_slope = 0;
+        } else {
+            t->sp_dst = t->sp_gain + (dst - t->sp_gain) * k;
+            t->sp_slope = (t->sp_dst - t->sp_gain) / nframes;
+        }
+    }
+}
+
+/* Decodes the block of compressed data holding sample `p` */
+static void _orion_track_fetch(struct orion_track *t, int p)
+{
+    int b = p / ORION_ADPCM_BLOCK;
+    orion_adpcm_decode_block(t->nch,
+        t->data->adpcm + (size_t)b * ORION_ADPCM_BLOCK_BYTES(t->nch), t->blk);
+    t->blk_start = b * ORION_ADPCM_BLOCK;
+    t->blk_end = t->blk_start + ORION_ADPCM_BLOCK;
+}
+
+/* Mixes a track into the buffer. Returns the number of samples played
+ * ahead of audio data still being produced, which are left silent. */
+static int _orion_track_step(struct orion_track *t, orion_smp *buf, int nch, int nsmp, int srate)
+{
+    if (t->state <= ORION_STOPPED) return 0;
+    int i, j, k;
     int p = t->play_pos;
+    int ready = SDL_AtomicGet(&t->data->ready), starved = 0;
+    SDL_MemoryBarrierAcquire();
     float v = t->volume;
-    int rend = t->ramp_end, rtime;
+    int rend = t->ramp_end, rtime = 0;
     double rslope = t->ramp_slope;
+    /* Dry filters keep running, so that raising the mix later does not click */
+    struct orion_filter *f = &t->filter;
+    unsigned char filtered = f->enabled;
+    float m = f->mix;
+    int mtime = 0;
+    /* Positional gain; tracks that are not positional get unity */
+    float g = (t->spatial ? t->sp_gain : 1);
     /* At the end of the following loop,
      * the updated play position will have been stored in `p` */
     for (i = 0; i <= nsmp; ++i) {
@@ -246,22 +1400,91 @@ static void _orion_track_step(struct orion_track *t, orion_smp *buf, int nch, in
             }
         }
         if (i == nsmp) break;
+        /* Advance the cutoff sweep block by block */
+        if (filtered && f->cutoff_end > 0 && i % ORION_FILTER_BLOCK == 0) {
+            int blk = f->cutoff_end < ORION_FILTER_BLOCK ?
+                f->cutoff_end : ORION_FILTER_BLOCK;
+            if ((f->cutoff_end -= blk) == 0) f->cutoff = f->cutoff_dst;
+            else f->cutoff *= pow(f->cutoff_mul, blk);
+            _orion_filter_design(f, srate);
+        }
         /* Write to the buffer */
+        const orion_smp *fr;
+        if (p >= ready) {
+            fr = NULL;
+            ++starved;
+        } else if (t->pcm != NULL) {
+            fr = t->pcm + p * nch;
+        } else {
+            if (p < t->blk_start || p >= t->blk_end) _orion_track_fetch(t, p);
+            fr = t->blk + (p - t->blk_start) * nch;
+        }
         for (j = 0; j < nch; ++j) {
-            buf[i * nch + j] += (short)(t->pcm[p * nch + j] * v + 0.5);
+            float x = (fr != NULL ? fr[j] : 0);
+            if (filtered && j < ORION_FILTER_MAXCH) {
+                float y = x;
+                for (k = 0; k < ORION_BUTTERWORTH_SECTIONS; ++k)
+                    y = orion_biquad_run(&f->sec[k], f->z[k][j], y);
+                x += (y - x) * m;
+            }
+            buf[i * nch + j] += _orion_round(x * v * g);
         }
-        /* Update volume */
+        /* Update volume and filter mix */
         if (rslope != 0) {
             rtime = i + 1;
             if (rtime > rend) rtime = rend;
             v = t->volume + rtime * rslope;
         }
+        if (f->mix_slope != 0) {
+            mtime = i + 1;
+            if (mtime > f->mix_end) mtime = f->mix_end;
+            m = f->mix + mtime * f->mix_slope;
+        }
+        /* Stop at the target, in case the next update does not come */
+        if (g != t->sp_dst && t->spatial) {
+            g += t->sp_slope;
+            if ((t->sp_slope > 0) == (g > t->sp_dst)) g = t->sp_dst;
+        }
         /* Update playback position; sanitization happens later */
         ++p;
     }
     t->play_pos = p;
     t->volume = v;
     if ((t->ramp_end -= rtime) == 0) t->ramp_slope = 0;
+    f->mix = m;
+    if ((f->mix_end -= mtime) == 0) f->mix_slope = 0;
+    if (t->spatial) t->sp_gain = g;
+    return starved;
+}
+
+/* Mixes a voice into the buffer, whose first sample is at timestamp `now`.
+ * Returns 0 if the voice has finished. */
+static int _orion_voice_step(struct orion_voice *v, const struct orion_sample *s,
+    orion_smp *buf, int nch, int nsmp, long now)
+{
+    int i = 0, j, rtime = 0;
+    if (v->start > now) {
+        if (v->start - now >= nsmp) return 1;
+        i = v->start - now;
+    }
+    int p = v->play_pos;
+    int snch = s->nch, len = s->len, i0 = i;
+    float sv = s->volume, v0 = v->volume, vol = v0;
+    double rslope = v->ramp_slope;
+    for (; i < nsmp && p < len; ++i, ++p) {
+        float g = vol * sv;
+        for (j = 0; j < nch; ++j)
+            buf[i * nch + j] += _orion_round(s->pcm[p * snch + (snch == 1 ? 0 : j)] * g);
+        if (rslope != 0) {
+            rtime = i - i0 + 1;
+            if (rtime > v->ramp_end) rtime = v->ramp_end;
+            vol = v0 + rtime * rslope;
+        }
+    }
+    v->play_pos = p;
+    v->volume = vol;
+    if ((v->ramp_end -= rtime) == 0) v->ramp_slope = 0;
+    return p < len;
 }
 
 /* The callback invoked by PortAudio.
@@ -273,25 +1496,131 @@ static int _orion_portaudio_callback(
 {
     struct orion *o = (struct orion *)_o;
     orion_smp *obuf = (orion_smp *)_obuf;
-    int i, j;
+    struct orion_track *t, *next_t;
+    int i;
+    Uint64 start_time = SDL_GetPerformanceCounter();
 
     /* XXX: Shorten the lock holding duration if not performant */
     SDL_AtomicLock(&o->lock);
+    if (flags & paOutputUnderflow) ++o->stats.underruns;
     int nch = o->nch;
     memset(obuf, 0, nframes * nch * sizeof(orion_smp));
-    for (i = 0; i < ORION_NUM_TRACKS; ++i)
-        if (o->track[i].state > ORION_STOPPED)
-            _orion_track_step(&o->track[i], obuf, nch, nframes);
-    o->timestamp += nframes;
+    for (t = o->active_tracks; t != NULL; t = t->slot.next)
+        _orion_track_jump(t, o->timestamp);
+    _orion_spatial_update(o, nframes);
+    double heard_at = o->heard_at;
+    long heard_ts = o->heard_ts;
+    if (time != NULL) {
+        /* Some host APIs do not provide the DAC time */
+        o->dac_time = (time->outputBufferDacTime > 0) ?
+            time->outputBufferDacTime : time->currentTime + o->latency;
+        /* Converted to the performance counter,
+         * so that readers need not touch the stream */
+        heard_at = (double)start_time / SDL_GetPerformanceFrequency()
+            + (o->dac_time - time->currentTime);
+        heard_ts = o->timestamp;
+    }
+    /* The buffer is split into segments at scheduled timestamps */
+    long now = o->timestamp, end = o->timestamp + nframes;
+    int starved = 0;
+    while (now < end) {
+        long next = end;
+        for (t = o->active_tracks; t != NULL; t = t->slot.next) {
+            if (t->sched_action == ORION_SCHED_NONE) continue;
+            if (t->sched_at > now) {
+                if (t->sched_at < next) next = t->sched_at;
+                continue;
+            }
+            switch (t->sched_action) {
+                case ORION_SCHED_ONCE: _orion_track_once(o, t); break;
+                case ORION_SCHED_RESUME: _orion_track_resume(o, t); break;
+                case ORION_SCHED_PAUSE: _orion_track_pause(t); break;
+                default: break;
+            }
+            t->sched_action = ORION_SCHED_NONE;
+            _orion_track_jump(t, now);
+        }
+        for (t = o->active_tracks; t != NULL; t = t->slot.next)
+            if (t->state > ORION_STOPPED)
+                starved += _orion_track_step(t,
+                    obuf + (now - o->timestamp) * nch, nch, next - now, o->srate);
+        now = next;
+    }
+    /* Dropped tracks stop when faded out; idle tracks leave the list
+     * after publishing their final state */
+    _orion_clock_begin(o);
+    for (t = o->active_tracks; t != NULL; t = next_t) {
+        next_t = t->slot.next;
+        if (t->slot.state == ORION_SLOT_DROPPING && t->ramp_slope == 0)
+            t->state = ORION_STOPPED;
+        _orion_track_stamp(t);
+        if (t->state <= ORION_STOPPED && t->sched_action == ORION_SCHED_NONE)
+            _orion_track_deactivate(o, t);
+    }
+    o->pub_timestamp = end;
+    o->heard_at = heard_at;
+    o->heard_ts = heard_ts;
+    _orion_clock_end(o);
+    /* Voices are only visited through the active list */
+    for (i = o->n_active - 1; i >= 0; --i) {
+        int vid = o->active[i];
+        if (!_orion_voice_step(&o->voice[vid], &o->sample[o->voice[vid].sid],
+                obuf, nch, nframes, o->timestamp))
+            _orion_voice_deactivate(o, vid);
+    }
+    o->timestamp = end;
+
+    double load = (double)(SDL_GetPerformanceCounter() - start_time)
+        / SDL_GetPerformanceFrequency() * o->srate / nframes;
+    ++o->stats.callbacks;
+    if (starved > 0) ++o->stats.starved;
+    o->stats.load_avg += load;
+    if (o->stats.load_max < load) o->stats.load_max = load;
     SDL_AtomicUnlock(&o->lock);
 
     return 0;
 }
 
-/* The subroutine that (re-)initializes PortAudio and starts playback. */
-static int _orion_playback_routine(void *_o)
+/* Opens and starts a stream, publishing it in the struct. */
+static PaStream *_orion_open_stream(struct orion *o,
+    const PaStreamParameters *param, int srate, int buf_frames)
+{
+    PaStream *stream;
+    PaError pa_err = Pa_OpenStream(
+        &stream, NULL, param, srate, buf_frames,
+        paNoFlag, _orion_portaudio_callback, o);
+    if (pa_err != paNoError) return NULL;
+    pa_err = Pa_StartStream(stream);
+    if (pa_err != paNoError) {
+        Pa_CloseStream(stream);
+        return NULL;
+    }
+
+    const PaStreamInfo *info = Pa_GetStreamInfo(stream);
+    SDL_AtomicLock(&o->lock);
+    o->stream = stream;
+    o->latency = (info != NULL) ? info->outputLatency : 0;
+    o->stats.buf_frames = buf_frames;
+    SDL_AtomicUnlock(&o->lock);
+    return stream;
+}
+
+static void _orion_close_stream(struct orion *o, PaStream *stream)
+{
+    SDL_AtomicLock(&o->lock);
+    o->stream = NULL;
+    o->dac_time = 0;
+    _orion_clock_begin(o);
+    o->heard_at = 0;
+    _orion_clock_end(o);
+    SDL_AtomicUnlock(&o->lock);
+    Pa_StopStream(stream);
+    Pa_CloseStream(stream);
+}
+
+/* Initializes PortAudio and plays until paused. */
+static int _orion_portaudio_run(struct orion *o)
 {
-    struct orion *o = (struct orion *)_o;
     PaError pa_err;
 
     pa_err = Pa_Initialize();
@@ -301,7 +1630,11 @@ static int _orion_playback_routine(void *_o)
     /* Retrieve parameters */
     SDL_AtomicLock(&o->lock);
     int srate = o->srate, nch = o->nch;
+    int buf_frames = o->buf_frames;
+    enum orion_latency lat_class = o->lat_class;
     SDL_AtomicUnlock(&o->lock);
+    unsigned char auto_tune = (buf_frames == 0);
+    if (auto_tune) buf_frames = ORION_AUTO_BUF_MIN;
 
     /* PortAudio setup */
     PaStreamParameters param;
@@ -310,28 +1643,45 @@ static int _orion_playback_routine(void *_o)
     if (param.device == paNoDevice) goto err;
     param.channelCount = nch;
     param.sampleFormat = paInt16;   /* FIXME: Keep in sync with orion_smp */
-    param.suggestedLatency =
+    param.suggestedLatency = (lat_class == ORION_LATENCY_HIGH) ?
+        Pa_GetDeviceInfo(param.device)->defaultHighOutputLatency :
         Pa_GetDeviceInfo(param.device)->defaultLowOutputLatency;
     param.hostApiSpecificStreamInfo = NULL;
 
-    /* TODO: Make framesPerBuffer (64) configurable */
-    pa_err = Pa_OpenStream(
-        &stream, NULL, &param, srate, 64,
-        paNoFlag, _orion_portaudio_callback, _o);
-    if (pa_err != paNoError) goto err;
-    pa_err = Pa_StartStream(stream);
-    if (pa_err != paNoError) goto err;
+    stream = _orion_open_stream(o, &param, srate, buf_frames);
+    if (stream == NULL) goto err;
 
     /* Enter the loop */
     static const int SLEEP_INTV = 10;
     unsigned char running = 1;
+    SDL_AtomicLock(&o->lock);
+    long xrun_base = o->stats.underruns;
+    SDL_AtomicUnlock(&o->lock);
     while (running) {
         Pa_Sleep(SLEEP_INTV);
         SDL_AtomicLock(&o->lock);
         running = o->is_playing;
+        long xruns = o->stats.underruns - xrun_base;
         SDL_AtomicUnlock(&o->lock);
+        /* Back off to a larger buffer if the current one keeps underrunning */
+        if (running && auto_tune && xruns >= ORION_AUTO_XRUNS &&
+            buf_frames < ORION_AUTO_BUF_MAX)
+        {
+            _orion_close_stream(o, stream);
+            buf_frames *= 2;
+            stream = _orion_open_stream(o, &param, srate, buf_frames);
+            if (stream == NULL) {
+                /* Keep the size that worked, and stop tuning */
+                buf_frames /= 2;
+                auto_tune = 0;
+                stream = _orion_open_stream(o, &param, srate, buf_frames);
+                if (stream == NULL) goto err;
+            }
+            xrun_base += xruns;
+        }
     }
 
+    _orion_close_stream(o, stream);
     Pa_Terminate();
     return 0;
 
@@ -341,6 +1691,126 @@ err:
     return 0;
 }
 
+/* Renders as fast as possible until paused, writing to `fp` if not NULL */
+static int _orion_offline_run(struct orion *o, FILE *fp)
+{
+    SDL_AtomicLock(&o->lock);
+    int nch = o->nch;
+    int buf_frames = (o->buf_frames > 0) ? o->buf_frames : ORION_AUTO_BUF_MIN;
+    o->stats.buf_frames = buf_frames;
+    SDL_AtomicUnlock(&o->lock);
+
+    orion_smp *buf = (orion_smp *)malloc(sizeof(orion_smp) * buf_frames * nch);
+    unsigned char running = 1;
+    int i;
+    while (running) {
+        orion_render(o, buf, buf_frames);
+        if (fp != NULL) {
+            if (IS_BIGENDIAN) for (i = 0; i < buf_frames * nch; ++i)
+                buf[i] = (orion_smp)(((unsigned short)buf[i] >> 8) | ((unsigned short)buf[i] << 8));
+            fwrite(buf, sizeof(orion_smp), buf_frames * nch, fp);
+        }
+        SDL_AtomicLock(&o->lock);
+        running = o->is_playing;
+        SDL_AtomicUnlock(&o->lock);
+    }
+    free(buf);
+    return 0;
+}
+
+static int _orion_null_run(struct orion *o)
+{
+    return _orion_offline_run(o, NULL);
+}
+
+static void _orion_write_le(FILE *fp, unsigned int x, int nbytes)
+{
+    int i;
+    for (i = 0; i < nbytes; ++i) fputc((x >> (i * 8)) & 0xff, fp);
+}
+
+static void _orion_write_wav_header(FILE *fp, int srate, int nch, unsigned int data_sz)
+{
+    fwrite("RIFF", 1, 4, fp);
+    _orion_write_le(fp, 36 + data_sz, 4);
+    fwrite("WAVEfmt ", 1, 8, fp);
+    _orion_write_le(fp, 16, 4);         /* Size of the format chunk */
+    _orion_write_le(fp, 1, 2);          /* PCM */
+    _orion_write_le(fp, nch, 2);
+    _orion_write_le(fp, srate, 4);
+    _orion_write_le(fp, srate * nch * sizeof(orion_smp), 4);
+    _orion_write_le(fp, nch * sizeof(orion_smp), 2);
+    _orion_write_le(fp, sizeof(orion_smp) * 8, 2);
+    fwrite("data", 1, 4, fp);
+    _orion_write_le(fp, data_sz, 4);
+}
+
+static int _orion_file_run(struct orion *o)
+{
+    SDL_AtomicLock(&o->lock);
+    int srate = o->srate, nch = o->nch;
+    long start = o->timestamp;
+    FILE *fp = (o->backend_arg != NULL) ? fopen(o->backend_arg, "wb") : NULL;
+    SDL_AtomicUnlock(&o->lock);
+    if (fp == NULL) return 1;
+
+    /* The sizes are filled in after rendering */
+    _orion_write_wav_header(fp, srate, nch, 0);
+    _orion_offline_run(o, fp);
+
+    SDL_AtomicLock(&o->lock);
+    long nframes = o->timestamp - start;
+    SDL_AtomicUnlock(&o->lock);
+    rewind(fp);
+    _orion_write_wav_header(fp, srate, nch, nframes * nch * sizeof(orion_smp));
+    fclose(fp);
+    return 0;
+}
+
+const struct orion_backend orion_backend_portaudio = { "portaudio", _orion_portaudio_run };
+const struct orion_backend orion_backend_null = { "null", _orion_null_run };
+const struct orion_backend orion_backend_file = { "file", _orion_file_run };
+
+/* The subroutine run on the playback thread. */
+static int _orion_playback_routine(void *_o)
+{
+    struct orion *o = (struct orion *)_o;
+    SDL_AtomicLock(&o->lock);
+    const struct orion_backend *backend = o->backend;
+    SDL_AtomicUnlock(&o->lock);
+    if (backend == NULL) backend = &orion_backend_portaudio;
+    int ret = backend->run(o);
+
+    /* If the backend gave up on its own, nobody will wait for this thread;
+     * mark playback as stopped so that it can be started again */
+    SDL_AtomicLock(&o->lock);
+    if (o->is_playing) {
+        o->is_playing = 0;
+        SDL_DetachThread(o->playback_thread);
+    }
+    SDL_AtomicUnlock(&o->lock);
+    return ret;
+}
+
+/* Selects where the mix goes; takes effect at the next `orion_overall_play()`.
+ * `arg` is the output path for the file backend. */
+void orion_set_backend(struct orion *o, const struct orion_backend *backend, const char *arg)
+{
+    SDL_AtomicLock(&o->lock);
+    char *free_ptr = o->backend_arg;
+    o->backend = backend;
+    o->backend_arg = (arg != NULL) ? strdup(arg) : NULL;
+    SDL_AtomicUnlock(&o->lock);
+    if (free_ptr != NULL) free(free_ptr);
+}
+
+/* Mixes the next `nframes` samples into `buf` on the calling thread,
+ * exactly as the playback callback would */
+void orion_render(struct orion *o, orion_smp *buf, int nframes)
+{
+    _orion_portaudio_callback(NULL, buf, nframes, NULL, 0, o);
+}
+
 void orion_overall_play(struct orion *o)
 {
     SDL_AtomicLock(&o->lock);
@@ -375,9 +1845,22 @@ exit:
 }
 
 long orion_overall_tell(struct orion *o)
+{
+    int seq;
+    long ret;
+    do {
+        while ((seq = SDL_AtomicGet(&o->clock_seq)) & 1) ;
+        SDL_MemoryBarrierAcquire();
+        ret = o->pub_timestamp;
+        SDL_MemoryBarrierAcquire();
+    } while (SDL_AtomicGet(&o->clock_seq) != seq);
+    return ret;
+}
+
+void orion_get_stats(struct orion *o, struct orion_stats *stats)
 {
     SDL_AtomicLock(&o->lock);
-    long ret = o->timestamp;
+    *stats = o->stats;
     SDL_AtomicUnlock(&o->lock);
-    return ret;
+    if (stats->callbacks > 0) stats->load_avg /= stats->callbacks;
 }
@@ -2,13 +2,32 @@
 #define _ORION_H
 
 #include "libs_wrapper.h"
+#include "biquad.h"
+#include "adpcm.h"
 
 #include <SDL.h>
 
 /* Type of samples */
 typedef signed short orion_smp;
-/* Number of tracks available */
-#define ORION_NUM_TRACKS    20
+/* Tracks are allocated in chunks, which never move once allocated */
+#define ORION_TRACK_CHUNK       16
+#define ORION_MAX_TRACK_CHUNKS  64
+/* A track handle holds the slot index in its lower bits
+ * and the generation of the slot in the upper bits */
+#define ORION_TRACK_IDX_BITS    10
+/* Number of sample slots and voices available for sound effects */
+#define ORION_NUM_SAMPLES   32
+#define ORION_NUM_VOICES    32
+/* Default size of unreferenced audio data kept in the cache; in bytes */
+#define ORION_CACHE_BUDGET  (32 << 20)
+/* Maximum number of channels processed by a filter insert */
+#define ORION_FILTER_MAXCH  2
+/* Number of samples between coefficient updates during a cutoff sweep */
+#define ORION_FILTER_BLOCK  32
+/* Time constant of positional gain changes; in seconds */
+#define ORION_SPATIAL_SMOOTH    0.03
+/* Number of input samples time-stretched at a time */
+#define ORION_STRETCH_CHUNK 6720
 
 enum orion_playstate {
     ORION_UNINIT = 0,
@@ -17,11 +36,97 @@ enum orion_playstate {
     ORION_LOOP
 };
 
+/* Life cycle of a track slot */
+enum orion_slot_state {
+    ORION_SLOT_FREE = 0,
+    ORION_SLOT_USED,
+    ORION_SLOT_DROPPING     /* Fading out; freed once stopped */
+};
+
+/* Bookkeeping of a track slot, kept when the track contents are replaced */
+struct orion_track_slot {
+    enum orion_slot_state state;
+    int idx;        /* Index of the slot */
+    int gen;        /* Incremented whenever the track is dropped */
+    int next_free;  /* Next slot in the free list; -1 at the end */
+    unsigned char active;   /* Whether the track is in the active list */
+    struct orion_track *prev, *next;    /* Neighbours in the active list */
+};
+
+struct orion_pcm;
+
+/* A time-stretch producing audio data on a background thread */
+struct orion_stretch {
+    struct orion *o;
+    struct st_stream *st;
+    struct orion_pcm *src;  /* Reference to the input */
+    orion_smp *raw;     /* Raw samples of the input */
+    int in_pos;         /* Number of input samples consumed */
+    SDL_atomic_t cancel;
+    SDL_Thread *thread;
+};
+
+/* Reference-counted audio data, shared by tracks and samples.
+ * Data decoded from files is cached by path. */
+struct orion_pcm {
+    char *path;     /* NULL for generated data, which is never cached */
+    int nch;        /* Number of channels */
+    int len;        /* Number of samples */
+    orion_smp *pcm; /* Raw sample data; channels interleaved;
+                     * NULL if the data is compressed */
+    unsigned char *adpcm;   /* IMA-ADPCM blocks if compressed, or NULL */
+    size_t adpcm_sz;        /* Size of `adpcm`; in bytes */
+    SDL_atomic_t ready;     /* Number of samples available for playback;
+                             * less than `len` while being produced */
+    struct orion_stretch *stretch;  /* The producer if any, or NULL */
+    int refs;       /* Number of tracks and samples using the data */
+    unsigned long last_use;     /* For evicting least recently used data */
+    struct orion_pcm *next;     /* Next entry in the cache */
+};
+
+/* A lowpass insert run in the callback */
+struct orion_filter {
+    unsigned char enabled;
+    double cutoff;              /* Current cutoff frequency; in Hz */
+    double cutoff_dst;          /* Cutoff at the end of the sweep; in Hz */
+    double cutoff_mul;          /* Cutoff sweep ratio; per sample */
+    int cutoff_end;             /* Time until end of the sweep; in samples */
+    float mix;                  /* Current wet/dry mix; 1 is fully filtered */
+    int mix_end;                /* Time until end of the mix ramp; in samples */
+    double mix_slope;           /* The mix ramp slope; in 1/sample */
+    struct orion_biquad sec[ORION_BUTTERWORTH_SECTIONS];
+    float z[ORION_BUTTERWORTH_SECTIONS][ORION_FILTER_MAXCH][2];
+};
+
+/* Actions that can be scheduled at an exact timestamp */
+enum orion_sched_action {
+    ORION_SCHED_NONE = 0,
+    ORION_SCHED_ONCE,   /* Play once from the beginning */
+    ORION_SCHED_RESUME,
+    ORION_SCHED_PAUSE
+};
+
+/* Playback state of a track, published for queries that do not lock */
+struct orion_track_clock {
+    int tid;        /* Handle of the track; -1 if the slot is not in use */
+    enum orion_playstate state;
+    int play_pos, clock_pos;
+    long clock_ts;
+    int loop_start, loop_end;
+};
+
 struct orion_track {
     /* About the audio data */
     int nch;        /* Number of channels */
     int len;        /* Number of samples; a sample has `nch` values */
-    orion_smp *pcm; /* Raw sample data; channels interleaved */
+    orion_smp *pcm; /* Raw sample data; channels interleaved;
+                     * NULL if the data is compressed */
+    struct orion_pcm *data; /* The reference holding `pcm` */
+
+    /* The most recently decoded block of compressed data,
+     * holding samples in [blk_start, blk_end) */
+    orion_smp blk[ORION_ADPCM_BLOCK * ORION_ADPCM_MAXCH];
+    int blk_start, blk_end;
 
     /* About the usual playback */
     int play_pos;   /* Current playback position; in samples */
@@ -32,6 +137,107 @@ struct orion_track {
     int loop_start, loop_end;   /* A-B repeat markers; in samples */
     int ramp_end;               /* Time until end of the ramp; in samples */
     double ramp_slope;          /* The ramp slope; in 1/sample */
+
+    struct orion_filter filter;
+
+    /* Playback position at timestamp `clock_ts`: the start of the last
+     * buffer, or the latest point where playback started or jumped */
+    int clock_pos;
+    long clock_ts;
+
+    /* About positional mixing */
+    unsigned char spatial;  /* Whether the gain comes from emitters */
+    float sp_gain;  /* Current positional gain, applied over `volume` */
+    float sp_dst;   /* Gain at the end of the current buffer */
+    float sp_slope; /* Gain change; per sample */
+    float sp_weight;    /* Scratch space for the callback */
+
+    /* About scheduled actions */
+    enum orion_sched_action sched_action;   /* Pending action, if any */
+    long sched_at;  /* Timestamp of the pending action; in samples */
+
+    struct orion_track_slot slot;
+    struct orion_track_clock pub;   /* Written only while publishing */
+};
+
+/* Sample data that can be played by any number of voices */
+struct orion_sample {
+    int nch;        /* Number of channels; either 1 or that of the output */
+    int len;        /* Number of samples */
+    orion_smp *pcm; /* Raw sample data; channels interleaved */
+    struct orion_pcm *data; /* The reference holding `pcm` */
+    float volume;   /* Applied to all voices of this sample */
+};
+
+/* A playing instance of a sample */
+struct orion_voice {
+    int sid;        /* The sample being played */
+    int play_pos;   /* Current playback position; in samples */
+    float volume;   /* Current playback volume */
+    int ramp_end;   /* Time until end of the ramp; in samples */
+    double ramp_slope;  /* The ramp slope; in 1/sample */
+    long start;     /* Timestamp at which playback starts */
+    unsigned char playing;
+    int active_idx; /* Index in the active list */
+    int gen;        /* Incremented on each reuse to invalidate old handles */
+};
+
+/* A point from which a track is heard, for positional mixing */
+struct orion_emitter {
+    int tid;
+    float x, y;
+};
+
+/* Where the emitters are heard from, and the overall gain they get */
+struct orion_listener {
+    float x, y;
+    float gain;
+};
+
+/* What to do when all voices are busy */
+enum orion_steal {
+    ORION_STEAL_OLDEST = 0,
+    ORION_STEAL_QUIETEST,
+    ORION_STEAL_NONE
+};
+
+struct orion;
+
+/* Where the mix is sent; `run` is called on the playback thread
+ * and should return once `is_playing` is cleared. Returning earlier,
+ * e.g. on errors, stops playback so that it can be started again */
+struct orion_backend {
+    const char *name;
+    int (*run)(struct orion *o);
+};
+
+/* Plays on the default output device; this is the default */
+extern const struct orion_backend orion_backend_portaudio;
+/* Renders as fast as possible and discards the result */
+extern const struct orion_backend orion_backend_null;
+/* Renders as fast as possible into a WAV file */
+extern const struct orion_backend orion_backend_file;
+
+/* Latency classes, picking the device's low or high suggested latency */
+enum orion_latency {
+    ORION_LATENCY_LOW = 0,
+    ORION_LATENCY_HIGH
+};
+
+/* Buffer sizes used when auto-tuning; the size is doubled
+ * whenever `ORION_AUTO_XRUNS` underruns happen with the current one */
+#define ORION_AUTO_BUF_MIN  64
+#define ORION_AUTO_BUF_MAX  2048
+#define ORION_AUTO_XRUNS    4
+
+struct orion_stats {
+    long callbacks;     /* Number of buffers rendered */
+    long underruns;     /* Number of buffers reported as underflown */
+    long starved;       /* Number of buffers where a track played ahead
+                         * of its audio data still being produced */
+    double load_avg;    /* Average callback duration over buffer duration */
+    double load_max;    /* Maximum callback duration over buffer duration */
+    int buf_frames;     /* Current number of frames per buffer */
 };
 
 struct orion {
@@ -39,27 +245,113 @@ struct orion {
     int nch;        /* Number of channels; all tracks should have `nch` or 1 */
     unsigned char is_playing;
     long timestamp; /* Total number of samples played */
-    struct orion_track track[ORION_NUM_TRACKS];
     SDL_SpinLock lock;
+
+    /* Tracks; the callback only visits the ones in the active list,
+     * which holds all playing tracks and those with a pending action */
+    struct orion_track *track_chunk[ORION_MAX_TRACK_CHUNKS];
+    int n_tracks;   /* Number of slots ever allocated */
+    int free_track; /* Head of the free list; -1 if empty */
+    struct orion_track *active_tracks;
+
     SDL_Thread *playback_thread;
+    const struct orion_backend *backend;    /* NULL for PortAudio */
+    char *backend_arg;
+
+    /* Sound effects */
+    struct orion_sample sample[ORION_NUM_SAMPLES];
+    struct orion_voice voice[ORION_NUM_VOICES];
+    int active[ORION_NUM_VOICES];   /* Indices of playing voices */
+    int n_active;
+    enum orion_steal steal;
+
+    /* Positional mixing; the listener is published with a sequence
+     * counter instead of the lock, which is odd while it is written */
+    struct orion_emitter *emitters;
+    int n_emitters;
+    struct orion_listener listener;
+    SDL_atomic_t listener_seq;
+    struct orion_listener listener_last;    /* Last consistent copy read
+                                             * by the audio thread */
+
+    /* Audio data cache; guarded by its own lock, which may be
+     * taken while holding `lock` but not the other way round */
+    SDL_SpinLock cache_lock;
+    struct orion_pcm *cache;    /* List of data decoded from files */
+    size_t pcm_bytes;           /* Size of all data held */
+    size_t cache_idle;          /* Size of cached data not referenced */
+    size_t cache_budget;        /* Maximum of `cache_idle` */
+    unsigned long cache_tick;
+
+    /* About the PortAudio stream */
+    void *stream;       /* The PortAudio stream; NULL if not playing */
+    double latency;     /* Output latency reported by the stream; in seconds */
+    double dac_time;    /* Stream time at which the last buffer is heard */
+
+    /* Published at the end of each buffer and whenever tracks change, along
+     * with `pub` of each track; with a sequence counter like the listener */
+    long pub_timestamp; /* `timestamp` at the end of the last buffer */
+    double heard_at;    /* Performance counter time at which the last
+                         * buffer is heard; in seconds; 0 if unknown */
+    long heard_ts;      /* `timestamp` at the start of that buffer */
+    SDL_atomic_t clock_seq;
+
+    /* About the stream configuration */
+    int buf_frames;     /* Frames per buffer; 0 if auto-tuned */
+    enum orion_latency lat_class;
+    struct orion_stats stats;   /* `load_avg` holds the sum of loads here */
 };
 
 struct orion orion_create(int srate, int nch);
+struct orion orion_create_ex(int srate, int nch,
+    int buf_frames, enum orion_latency lat_class);
 void orion_drop(struct orion *o);
+int orion_track_create(struct orion *o);
+void orion_track_drop(struct orion *o, int tid, float secs);
+void orion_cache_budget(struct orion *o, size_t bytes);
+size_t orion_cache_usage(struct orion *o, size_t *idle);
 
 const char *orion_load_ogg(struct orion *o, int tid, const char *path);
+void orion_load_raw(struct orion *o, int tid, int nch, int len, const orion_smp *pcm);
 void orion_apply_lowpass(struct orion *o, int tid, int did, double cutoff);
 void orion_apply_stretch(struct orion *o, int tid, int did, double delta_pc);
+/* Like `orion_apply_stretch()`, but only the first `sync_len` samples are
+ * produced before returning; the rest is produced on a background thread.
+ * The length is known at once, so loop points can be set right away. */
+void orion_apply_stretch_lazy(struct orion *o, int tid, int did, double delta_pc, int sync_len);
+/* Waits until the audio data of a track is fully produced */
+void orion_wait(struct orion *o, int tid);
+void orion_share(struct orion *o, int tid, int did);
+void orion_compress(struct orion *o, int tid);
+const char *orion_load_sample(struct orion *o, int sid, const char *path);
+void orion_load_sample_raw(struct orion *o, int sid, int nch, int len, const orion_smp *pcm);
+void orion_sample_volume(struct orion *o, int sid, float vol);
+void orion_voice_policy(struct orion *o, enum orion_steal policy);
+int orion_voice_play(struct orion *o, int sid);
+int orion_voice_play_at(struct orion *o, int sid, long at);
+void orion_voice_stop(struct orion *o, int handle);
+void orion_voice_ramp(struct orion *o, int handle, float secs, float dst);
 void orion_play_once(struct orion *o, int tid);
 void orion_play_loop(struct orion *o, int tid, int intro_pos, int start_pos, int end_pos);
 void orion_pause(struct orion *o, int tid);
 void orion_resume(struct orion *o, int tid);
+void orion_schedule(struct orion *o, const int *tids, int n,
+    long at, enum orion_sched_action action);
 void orion_seek(struct orion *o, int tid, int pos);
 int orion_tell(struct orion *o, int tid);
+double orion_tell_precise(struct orion *o, int tid);
 void orion_ramp(struct orion *o, int tid, float secs, float dst);
 void orion_try_ramp(struct orion *o, int tid, float secs, float dst);
+void orion_filter_lowpass(struct orion *o, int tid, float secs, double cutoff);
+void orion_filter_mix(struct orion *o, int tid, float secs, float dst);
+void orion_spatial_track(struct orion *o, int tid, int on);
+void orion_spatial_emitters(struct orion *o, const struct orion_emitter *emitters, int n);
+void orion_spatial_listener(struct orion *o, float x, float y, float gain);
+void orion_set_backend(struct orion *o, const struct orion_backend *backend, const char *arg);
+void orion_render(struct orion *o, orion_smp *buf, int nframes);
 void orion_overall_play(struct orion *o);
 void orion_overall_pause(struct orion *o);
 long orion_overall_tell(struct orion *o);
+void orion_get_stats(struct orion *o, struct orion_stats *stats);
 
 #endif
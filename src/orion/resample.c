@@ -0,0 +1,119 @@
+#include "resample.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __SSE__
+#include <xmmintrin.h>
+#endif
+
+/* Number of filter taps per output sample; a multiple of 4 */
+#define TAPS    32
+/* Number of fractional positions tabulated; the filter for positions
+ * in between is interpolated linearly from the two nearest ones */
+#define PHASES  256
+/* Shape parameter of the Kaiser window; about 80 dB of stopband attenuation */
+#define KAISER_BETA 8.0
+
+/* Zeroth order modified Bessel function of the first kind */
+static double bessel_i0(double x)
+{
+    double sum = 1, term = 1;
+    int k;
+    for (k = 1; k < 32; ++k) {
+        term *= (x / (2 * k)) * (x / (2 * k));
+        sum += term;
+        if (term < sum * 1e-12) break;
+    }
+    return sum;
+}
+
+/* Fills in `PHASES + 1` rows of `TAPS` coefficients each.
+ * Row `ph` is applied to input samples `i - TAPS/2 + 1` through `i + TAPS/2`
+ * when the output lies at position `i + ph / PHASES` of the input. */
+static void design_filter(float *coef, double cutoff)
+{
+    double norm = bessel_i0(KAISER_BETA);
+    int ph, k;
+    for (ph = 0; ph <= PHASES; ++ph) {
+        float *row = coef + ph * TAPS;
+        double sum = 0;
+        for (k = 0; k < TAPS; ++k) {
+            double x = k - TAPS / 2 + 1 - (double)ph / PHASES;
+            double r = x / (TAPS / 2);
+            double w = (r * r < 1) ? bessel_i0(KAISER_BETA * sqrt(1 - r * r)) / norm : 0;
+            double s = (x == 0) ? 1 : sin(2 * M_PI * cutoff * x) / (2 * M_PI * cutoff * x);
+            row[k] = (float)(s * w);
+            sum += row[k];
+        }
+        /* Unity gain at DC for every phase */
+        for (k = 0; k < TAPS; ++k) row[k] /= sum;
+    }
+}
+
+static inline float dot(const float *a, const float *b)
+{
+#ifdef __SSE__
+    __m128 acc = _mm_setzero_ps();
+    int k;
+    for (k = 0; k < TAPS; k += 4)
+        acc = _mm_add_ps(acc, _mm_mul_ps(_mm_loadu_ps(a + k), _mm_loadu_ps(b + k)));
+    acc = _mm_add_ps(acc, _mm_movehl_ps(acc, acc));
+    acc = _mm_add_ss(acc, _mm_shuffle_ps(acc, acc, 1));
+    return _mm_cvtss_f32(acc);
+#else
+    float acc[4] = { 0 };
+    int k;
+    for (k = 0; k < TAPS; k += 4) {
+        acc[0] += a[k] * b[k];
+        acc[1] += a[k + 1] * b[k + 1];
+        acc[2] += a[k + 2] * b[k + 2];
+        acc[3] += a[k + 3] * b[k + 3];
+    }
+    return (acc[0] + acc[1]) + (acc[2] + acc[3]);
+#endif
+}
+
+int orion_resample(int src_rate, int dst_rate, int nch, int nsmp,
+    const short *inbuf, short **outbuf)
+{
+    int outlen = (int)(((long long)nsmp * dst_rate + src_rate - 1) / src_rate);
+    short *out = (short *)malloc(sizeof(short) * outlen * nch + 8);
+    *outbuf = out;
+    if (outlen == 0) return 0;
+
+    /* Lower the cutoff below the output's Nyquist frequency when downsampling;
+     * expressed relative to the input sample rate */
+    double cutoff = 0.5 * (dst_rate < src_rate ? (double)dst_rate / src_rate : 1) * 0.95;
+    float *coef = (float *)malloc(sizeof(float) * (PHASES + 1) * TAPS);
+    design_filter(coef, cutoff);
+
+    /* One channel at a time, zero-padded so that taps never go out of range;
+     * input sample `m` is stored at `pad[m + TAPS / 2]` */
+    int padlen = nsmp + TAPS + 1;
+    float *pad = (float *)malloc(sizeof(float) * padlen);
+    int c, i, n;
+    for (c = 0; c < nch; ++c) {
+        memset(pad, 0, sizeof(float) * padlen);
+        for (i = 0; i < nsmp; ++i) pad[i + TAPS / 2] = inbuf[i * nch + c];
+
+        for (n = 0; n < outlen; ++n) {
+            long long pos = (long long)n * src_rate;
+            int idx = (int)(pos / dst_rate);
+            double frac = (double)(pos % dst_rate) / dst_rate * PHASES;
+            int ph = (int)frac;
+            float w = (float)(frac - ph);
+            const float *x = pad + idx + 1;
+            float y0 = dot(coef + ph * TAPS, x);
+            float y1 = dot(coef + (ph + 1) * TAPS, x);
+            float y = y0 + (y1 - y0) * w;
+            y += (y >= 0 ? 0.5f : -0.5f);
+            out[n * nch + c] = (short)(y > 32767 ? 32767 : y < -32768 ? -32768 : y);
+        }
+    }
+
+    free(pad);
+    free(coef);
+    return outlen;
+}
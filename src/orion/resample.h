@@ -0,0 +1,18 @@
+#ifndef _ORION_RESAMPLE_H
+#define _ORION_RESAMPLE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Resamples 16-bit interleaved audio with a windowed-sinc polyphase filter.
+ * nsmp - number of samples in inbuf; a stereo sample is considered 1 sample
+ * Returns the number of samples in outbuf, which needs to be free()'d */
+int orion_resample(int src_rate, int dst_rate, int nch, int nsmp,
+    const short *inbuf, short **outbuf);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,210 @@
+/* Benchmarks of the mixer and the offline processing functions.
+ * Usage: orion_bench [file.ogg] [results.csv]
+ * Results are written as CSV lines of `benchmark,parameter,value,unit` */
+
+#include "../orion.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#define SRATE   44100
+#define NCH     2
+/* Maximum number of tracks mixed */
+#define MIX_TRACKS  20
+
+static FILE *out;
+
+static double now()
+{
+    return (double)SDL_GetPerformanceCounter() / SDL_GetPerformanceFrequency();
+}
+
+static void report(const char *bench, const char *param, double value, const char *unit)
+{
+    printf("%-24s %-12s %16.3f %s\n", bench, param, value, unit);
+    fprintf(out, "%s,%s,%.6f,%s\n", bench, param, value, unit);
+}
+
+/* Creates a track with `secs` seconds of white noise */
+static int load_noise(struct orion *o, double secs)
+{
+    int tid = orion_track_create(o);
+    int len = secs * SRATE, i;
+    orion_smp *pcm = malloc(sizeof(orion_smp) * len * NCH);
+    for (i = 0; i < len * NCH; ++i) pcm[i] = rand() % 20000 - 10000;
+    orion_load_raw(o, tid, NCH, len, pcm);
+    free(pcm);
+    return tid;
+}
+
+/* Time taken to mix a buffer, with 1 to all tracks playing */
+static void bench_mix()
+{
+    static const int BUF_FRAMES = 512, ROUNDS = 2000;
+    orion_smp buf[512 * NCH];
+    struct orion o = orion_create(SRATE, NCH);
+    int tids[MIX_TRACKS], n, i;
+    tids[0] = load_noise(&o, 10);
+    for (n = 1; n < MIX_TRACKS; ++n) {
+        tids[n] = orion_track_create(&o);
+        orion_share(&o, tids[0], tids[n]);
+    }
+
+    char param[16];
+    for (n = 1; n <= MIX_TRACKS; ++n) {
+        orion_play_loop(&o, tids[n - 1], 0, 0, -1);
+        orion_ramp(&o, tids[n - 1], 0, 1.0 / MIX_TRACKS);
+        for (i = 0; i < ROUNDS / 10; ++i) orion_render(&o, buf, BUF_FRAMES);
+        double t = now();
+        for (i = 0; i < ROUNDS; ++i) orion_render(&o, buf, BUF_FRAMES);
+        t = (now() - t) / ROUNDS;
+        snprintf(param, sizeof param, "%d_tracks", n);
+        report("mix_buffer", param, t * 1e6, "us");
+        report("mix_load", param, t / ((double)BUF_FRAMES / SRATE) * 100, "percent");
+    }
+    orion_drop(&o);
+}
+
+static int cmp_double(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+    return x < y ? -1 : x > y;
+}
+
+static SDL_atomic_t rendering;
+
+/* Renders a buffer every buffer duration, like a device would */
+static int paced_render(void *_o)
+{
+    static const int BUF_FRAMES = 256;
+    orion_smp buf[256 * NCH];
+    while (SDL_AtomicGet(&rendering)) {
+        orion_render((struct orion *)_o, buf, BUF_FRAMES);
+        SDL_Delay(BUF_FRAMES * 1000 / SRATE);
+    }
+    return 0;
+}
+
+/* Latency of calls from another thread while the callback keeps running;
+ * either paced like a device or rendering back-to-back */
+static void bench_contention(int paced)
+{
+    static const int CALLS = 100000;
+    struct orion o = orion_create(SRATE, NCH);
+    int tids[8], i;
+    tids[0] = load_noise(&o, 10);
+    for (i = 1; i < 8; ++i) {
+        tids[i] = orion_track_create(&o);
+        orion_share(&o, tids[0], tids[i]);
+    }
+    for (i = 0; i < 8; ++i) {
+        orion_play_loop(&o, tids[i], 0, 0, -1);
+        orion_ramp(&o, tids[i], 0, 0.1);
+    }
+    SDL_Thread *th = NULL;
+    if (paced) {
+        SDL_AtomicSet(&rendering, 1);
+        th = SDL_CreateThread(paced_render, "Orion bench render", &o);
+    } else {
+        orion_set_backend(&o, &orion_backend_null, NULL);
+        orion_overall_play(&o);
+    }
+
+    double *lat = malloc(sizeof(double) * CALLS);
+    int k;
+    for (k = 0; k < 2; ++k) {
+        for (i = 0; i < CALLS; ++i) {
+            double t = now();
+            if (k == 0) orion_tell(&o, tids[i % 8]);
+            else orion_ramp(&o, tids[i % 8], 0.01, (i % 2) * 0.1);
+            lat[i] = now() - t;
+        }
+        qsort(lat, CALLS, sizeof(double), cmp_double);
+        double sum = 0;
+        for (i = 0; i < CALLS; ++i) sum += lat[i];
+        char bench[32];
+        snprintf(bench, sizeof bench, "%s_latency_%s",
+            k == 0 ? "tell" : "ramp", paced ? "paced" : "busy");
+        report(bench, "mean", sum / CALLS * 1e9, "ns");
+        report(bench, "p99", lat[CALLS * 99 / 100] * 1e9, "ns");
+        report(bench, "max", lat[CALLS - 1] * 1e9, "ns");
+    }
+    free(lat);
+
+    if (paced) {
+        SDL_AtomicSet(&rendering, 0);
+        SDL_WaitThread(th, NULL);
+    } else {
+        orion_overall_pause(&o);
+    }
+    orion_drop(&o);
+}
+
+/* Throughput of the offline processing functions */
+static void bench_processing()
+{
+    static const double SECS = 20;
+    struct orion o = orion_create(SRATE, NCH);
+    int src = load_noise(&o, SECS), dst = orion_track_create(&o);
+
+    double t = now();
+    orion_apply_lowpass(&o, src, dst, 880);
+    t = now() - t;
+    report("lowpass", "880Hz", SECS * SRATE / t, "samples/s");
+
+    t = now();
+    orion_apply_stretch(&o, src, dst, 25);
+    t = now() - t;
+    report("stretch", "+25%", SECS * SRATE / t, "samples/s");
+
+    /* Time until a lazily stretched track can start playing */
+    t = now();
+    orion_apply_stretch_lazy(&o, src, dst, 25, 2 * SRATE);
+    t = now() - t;
+    report("stretch_lazy", "2s_ahead", t * 1e3, "ms");
+    orion_wait(&o, dst);
+
+    orion_drop(&o);
+}
+
+/* Time taken to decode a file, bypassing the cache */
+static void bench_load(const char *path)
+{
+    static const int ROUNDS = 5;
+    double total = 0;
+    int i;
+    for (i = 0; i < ROUNDS; ++i) {
+        struct orion o = orion_create(SRATE, NCH);
+        int tid = orion_track_create(&o);
+        double t = now();
+        const char *msg = orion_load_ogg(&o, tid, path);
+        total += now() - t;
+        orion_drop(&o);
+        if (msg != NULL) {
+            printf("%s: %s\n", path, msg);
+            return;
+        }
+    }
+    report("load_ogg", path, total / ROUNDS * 1e3, "ms");
+}
+
+int main(int argc, char *argv[])
+{
+    const char *ogg_path = (argc >= 2 ? argv[1] : "sketchch.ogg");
+    const char *out_path = (argc >= 3 ? argv[2] : "orion_bench.csv");
+    out = fopen(out_path, "w");
+    if (out == NULL) {
+        printf("Cannot open %s\n", out_path);
+        return 1;
+    }
+    fprintf(out, "benchmark,parameter,value,unit\n");
+
+    bench_mix();
+    bench_contention(1);
+    bench_contention(0);
+    bench_processing();
+    bench_load(ogg_path);
+
+    fclose(out);
+    return 0;
+}
@@ -0,0 +1,652 @@
+/* Deterministic checks of the mixer, rendered without an audio device */
+
+#include "../orion.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define NCH 2
+
+static int failures = 0;
+
+#define CHECK(__cond, ...) do { \
+    if (!(__cond)) { \
+        printf("FAIL %s:%d: ", __func__, __LINE__); \
+        printf(__VA_ARGS__); \
+        putchar('\n'); \
+        ++failures; \
+        return; \
+    } \
+} while (0)
+
+/* Creates a stereo track where the sample at position i is (i, -i) */
+static int load_ramp(struct orion *o, int len)
+{
+    int tid = orion_track_create(o);
+    orion_smp *pcm = malloc(sizeof(orion_smp) * len * NCH);
+    int i;
+    for (i = 0; i < len; ++i) {
+        pcm[i * NCH] = i;
+        pcm[i * NCH + 1] = -i;
+    }
+    orion_load_raw(o, tid, NCH, len, pcm);
+    orion_ramp(o, tid, 0, 1);
+    free(pcm);
+    return tid;
+}
+
+static int load_const(struct orion *o, int len, orion_smp val)
+{
+    int tid = orion_track_create(o);
+    orion_smp *pcm = malloc(sizeof(orion_smp) * len * NCH);
+    int i;
+    for (i = 0; i < len * NCH; ++i) pcm[i] = val;
+    orion_load_raw(o, tid, NCH, len, pcm);
+    orion_ramp(o, tid, 0, 1);
+    free(pcm);
+    return tid;
+}
+
+static void test_once()
+{
+    struct orion o = orion_create(44100, NCH);
+    orion_smp buf[128 * NCH];
+    int tid = load_ramp(&o, 100);
+    orion_play_once(&o, tid);
+    orion_render(&o, buf, 128);
+    int i;
+    for (i = 0; i < 128; ++i) {
+        int expected = (i < 100 ? i : 0);
+        CHECK(buf[i * NCH] == expected && buf[i * NCH + 1] == -expected,
+            "frame %d is (%d, %d), expected %d", i, buf[i * NCH], buf[i * NCH + 1], expected);
+    }
+    orion_render(&o, buf, 128);
+    for (i = 0; i < 128 * NCH; ++i)
+        CHECK(buf[i] == 0, "output after the end of a one-shot track");
+    CHECK(orion_overall_tell(&o) == 256, "timestamp is %ld", orion_overall_tell(&o));
+    orion_drop(&o);
+}
+
+static void test_loop()
+{
+    struct orion o = orion_create(44100, NCH);
+    orion_smp buf[64 * NCH];
+    int tid = load_ramp(&o, 100);
+    orion_play_loop(&o, tid, 0, 20, 60);
+    int i, j, p = 0;
+    /* Buffer boundaries should not matter */
+    for (j = 0; j < 5; ++j) {
+        orion_render(&o, buf, 64);
+        for (i = 0; i < 64; ++i) {
+            CHECK(buf[i * NCH] == p, "frame %d is %d, expected %d", j * 64 + i, buf[i * NCH], p);
+            if (++p == 60) p = 20;
+        }
+    }
+    CHECK(orion_tell(&o, tid) == p, "position is %d, expected %d", orion_tell(&o, tid), p);
+    orion_drop(&o);
+}
+
+static void test_tell()
+{
+    struct orion o = orion_create(44100, NCH);
+    orion_smp buf[64 * NCH];
+    int tid = load_ramp(&o, 100);
+    orion_play_loop(&o, tid, 0, 20, 60);
+    orion_render(&o, buf, 64);
+    /* Queries should not wait for the lock, as if the callback were mixing */
+    SDL_AtomicLock(&o.lock);
+    int pos = orion_tell(&o, tid);
+    long ts = orion_overall_tell(&o);
+    int stale = orion_tell(&o, tid + (1 << ORION_TRACK_IDX_BITS));
+    SDL_AtomicUnlock(&o.lock);
+    CHECK(pos == 24, "position is %d, expected 24", pos);
+    CHECK(ts == 64, "timestamp is %ld", ts);
+    CHECK(stale == -1, "stale handle reports %d", stale);
+    /* Changes are visible before the next buffer */
+    orion_seek(&o, tid, 42);
+    CHECK(orion_tell(&o, tid) == 42, "position is %d after seeking", orion_tell(&o, tid));
+    orion_track_drop(&o, tid, 0);
+    CHECK(orion_tell(&o, tid) == -1, "dropped track reports %d", orion_tell(&o, tid));
+    orion_drop(&o);
+}
+
+/* Pretends that the buffer starting at `ts` was heard `ago` seconds ago,
+ * as the callback records it when the stream reports timing */
+static void set_heard(struct orion *o, long ts, double ago)
+{
+    SDL_AtomicLock(&o->lock);
+    o->heard_ts = ts;
+    o->heard_at = (double)SDL_GetPerformanceCounter() / SDL_GetPerformanceFrequency() - ago;
+    SDL_AtomicUnlock(&o->lock);
+}
+
+static void test_tell_precise()
+{
+    /* One sample per millisecond, so that timing jitter stays well below one */
+    struct orion o = orion_create(1000, NCH);
+    orion_smp buf[64 * NCH];
+    int tid = load_ramp(&o, 1000);
+    double pos;
+    orion_play_loop(&o, tid, 0, 0, 999);
+    orion_render(&o, buf, 64);
+    set_heard(&o, 0, 0.02);
+    pos = orion_tell_precise(&o, tid);
+    CHECK(fabs(pos - 20) < 1, "position is %.2f, expected 20", pos);
+    /* A seek is heard from the next buffer on */
+    orion_seek(&o, tid, 500);
+    pos = orion_tell_precise(&o, tid);
+    CHECK(pos == 500, "position is %.2f after seeking", pos);
+    /* A scheduled resume is heard from its own sample */
+    orion_pause(&o, tid);
+    orion_render(&o, buf, 64);
+    int tids[1] = { tid };
+    orion_schedule(&o, tids, 1, 138, ORION_SCHED_RESUME);
+    orion_render(&o, buf, 64);
+    set_heard(&o, 128, 0.03);
+    pos = orion_tell_precise(&o, tid);
+    CHECK(fabs(pos - 520) < 1, "position is %.2f, expected 520", pos);
+    orion_drop(&o);
+}
+
+static void test_ramp()
+{
+    struct orion o = orion_create(1000, NCH);
+    orion_smp buf[200 * NCH];
+    int tid = load_const(&o, 1000, 1000);
+    orion_ramp(&o, tid, 0, 0);
+    orion_play_once(&o, tid);
+    /* 0.1 s at 1000 Hz is 100 samples */
+    orion_ramp(&o, tid, 0.1, 1);
+    orion_render(&o, buf, 200);
+    int i;
+    CHECK(buf[0] == 0, "ramp starts at %d", buf[0]);
+    for (i = 1; i <= 100; ++i)
+        CHECK(abs(buf[i * NCH] - i * 10) <= 1, "frame %d is %d, expected %d", i, buf[i * NCH], i * 10);
+    for (i = 100; i < 200; ++i)
+        CHECK(buf[i * NCH] == 1000, "frame %d is %d after the ramp", i, buf[i * NCH]);
+    orion_drop(&o);
+}
+
+static void test_schedule()
+{
+    struct orion o = orion_create(44100, NCH);
+    orion_smp buf[64 * NCH];
+    int tids[2], i;
+    tids[0] = load_const(&o, 1000, 100);
+    tids[1] = load_const(&o, 1000, 10);
+    for (i = 0; i < 2; ++i) {
+        orion_play_loop(&o, tids[i], 0, 0, 999);
+        orion_pause(&o, tids[i]);
+        orion_seek(&o, tids[i], 0);
+    }
+    orion_schedule(&o, tids, 2, 64 + 37, ORION_SCHED_RESUME);
+    orion_render(&o, buf, 64);
+    for (i = 0; i < 64; ++i)
+        CHECK(buf[i * NCH] == 0, "output before the scheduled start");
+    orion_render(&o, buf, 64);
+    for (i = 0; i < 64; ++i)
+        CHECK(buf[i * NCH] == (i < 37 ? 0 : 110),
+            "frame %d is %d around the scheduled start", 64 + i, buf[i * NCH]);
+    CHECK(orion_tell(&o, tids[0]) == 27 && orion_tell(&o, tids[1]) == 27,
+        "positions are %d and %d, expected 27",
+        orion_tell(&o, tids[0]), orion_tell(&o, tids[1]));
+    orion_drop(&o);
+}
+
+static void test_filter()
+{
+    struct orion o = orion_create(44100, NCH);
+    orion_smp dry[256 * NCH], buf[256 * NCH];
+    int a = load_ramp(&o, 1000), b = orion_track_create(&o);
+    orion_share(&o, a, b);
+    orion_ramp(&o, b, 0, 1);
+
+    /* A fully dry filter leaves the track untouched */
+    orion_play_once(&o, a);
+    orion_render(&o, dry, 256);
+    orion_pause(&o, a);
+    orion_filter_lowpass(&o, b, 0, 1000);
+    orion_filter_mix(&o, b, 0, 0);
+    orion_play_once(&o, b);
+    orion_render(&o, buf, 256);
+    CHECK(memcmp(dry, buf, sizeof dry) == 0, "dry filter changes the output");
+    orion_drop(&o);
+
+    /* DC passes through a lowpass filter */
+    o = orion_create(44100, NCH);
+    a = load_const(&o, 4000, 1000);
+    orion_filter_lowpass(&o, a, 0, 500);
+    orion_play_once(&o, a);
+    int i;
+    for (i = 0; i < 8; ++i) orion_render(&o, buf, 256);
+    CHECK(abs(buf[255 * NCH] - 1000) <= 1, "DC level %d after lowpass", buf[255 * NCH]);
+    orion_drop(&o);
+
+    /* The filter settles while dry, so that wetting it does not jump */
+    o = orion_create(44100, NCH);
+    a = load_const(&o, 4000, 1000);
+    orion_filter_lowpass(&o, a, 0, 500);
+    orion_filter_mix(&o, a, 0, 0);
+    orion_play_once(&o, a);
+    for (i = 0; i < 8; ++i) orion_render(&o, buf, 256);
+    orion_filter_mix(&o, a, 0, 1);
+    orion_render(&o, buf, 256);
+    CHECK(abs(buf[0] - 1000) <= 1, "DC level %d after wetting the filter", buf[0]);
+    orion_drop(&o);
+}
+
+static void test_tracks()
+{
+    struct orion o = orion_create(1000, NCH);
+    orion_smp buf[200 * NCH];
+    int a = load_const(&o, 1000, 1000), b, i;
+    orion_track_drop(&o, a, 0);
+    CHECK(orion_tell(&o, a) == -1, "dropped track is still valid");
+    b = orion_track_create(&o);
+    CHECK(b != a && b != -1, "handle %d given after dropping %d", b, a);
+
+    /* Tables grow past a chunk */
+    int tids[100];
+    for (i = 0; i < 100; ++i) {
+        tids[i] = load_const(&o, 10, 1);
+        orion_play_once(&o, tids[i]);
+    }
+    memset(buf, 0, sizeof buf);
+    orion_render(&o, buf, 20);
+    CHECK(buf[0] == 100 && buf[10 * NCH] == 0, "frames are %d and %d, expected 100 and 0",
+        buf[0], buf[10 * NCH]);
+    CHECK(o.active_tracks == NULL, "finished tracks stay in the active list");
+    for (i = 0; i < 100; ++i) orion_track_drop(&o, tids[i], 0);
+
+    /* Dropping with a fade keeps playing until faded out */
+    a = load_const(&o, 1000, 1000);
+    orion_play_loop(&o, a, 0, 0, 999);
+    orion_track_drop(&o, a, 0.1);
+    CHECK(orion_tell(&o, a) == -1, "track being dropped is still valid");
+    memset(buf, 0, sizeof buf);
+    orion_render(&o, buf, 200);
+    CHECK(buf[0] == 1000 && abs(buf[50 * NCH] - 500) <= 1 && buf[150 * NCH] == 0,
+        "fade-out frames are %d, %d and %d", buf[0], buf[50 * NCH], buf[150 * NCH]);
+    CHECK(o.active_tracks == NULL, "faded out track stays in the active list");
+    orion_drop(&o);
+}
+
+static void test_spatial()
+{
+    struct orion o = orion_create(1000, NCH);
+    orion_smp buf[100 * NCH];
+    int a = load_const(&o, 1000, 1000), b = load_const(&o, 1000, 0);
+    int c = load_const(&o, 1000, 10), i;
+    struct orion_emitter e[3] = { { a, 0, 0 }, { b, 3, 0 }, { b, 4, 1 } };
+    orion_spatial_track(&o, a, 1);
+    orion_spatial_track(&o, b, 1);
+    orion_spatial_emitters(&o, e, 2);
+    orion_spatial_listener(&o, 1, 0, 1);
+    orion_play_loop(&o, a, 0, 0, 999);
+    orion_play_loop(&o, b, 0, 0, 999);
+    orion_play_loop(&o, c, 0, 0, 999);
+    /* Track `a` gets 1 / (1 + 1/2) of the gain; `c` is not positional */
+    for (i = 0; i < 10; ++i) orion_render(&o, buf, 100);
+    CHECK(abs(buf[99 * NCH] - (667 + 10)) <= 2, "output is %d, expected 677", buf[99 * NCH]);
+    /* Changes are smoothed */
+    orion_spatial_listener(&o, 3, 0, 1);
+    orion_render(&o, buf, 100);
+    CHECK(buf[0] > 600 && buf[99 * NCH] < 100, "output goes from %d to %d after moving",
+        buf[0], buf[99 * NCH]);
+    for (i = 0; i < 10; ++i) orion_render(&o, buf, 100);
+    CHECK(abs(buf[99 * NCH] - 10) <= 2, "output is %d next to the other emitter", buf[99 * NCH]);
+    /* A positional track that loses its emitters fades out */
+    orion_spatial_listener(&o, 1, 0, 1);
+    orion_spatial_emitters(&o, e + 1, 2);
+    for (i = 0; i < 10; ++i) orion_render(&o, buf, 100);
+    CHECK(abs(buf[99 * NCH] - 10) <= 2, "output is %d once `a` has no emitters",
+        buf[99 * NCH]);
+    orion_spatial_track(&o, a, 0);
+    orion_render(&o, buf, 100);
+    CHECK(buf[0] == 1010, "output is %d once `a` is no longer positional", buf[0]);
+    orion_drop(&o);
+}
+
+/* Positional tracks are silent when there are no emitters at all */
+static void test_spatial_none()
+{
+    struct orion o = orion_create(1000, NCH);
+    orion_smp buf[100 * NCH];
+    int a = load_const(&o, 1000, 1000), c = load_const(&o, 1000, 10);
+    orion_spatial_track(&o, a, 1);
+    orion_spatial_listener(&o, 0, 0, 1);
+    orion_play_loop(&o, a, 0, 0, 999);
+    orion_play_loop(&o, c, 0, 0, 999);
+    orion_render(&o, buf, 100);
+    CHECK(buf[0] == 10 && buf[99 * NCH] == 10, "output is %d, %d without emitters",
+        buf[0], buf[99 * NCH]);
+    /* Nor does the listener gain let it through */
+    orion_spatial_listener(&o, 0, 0, 0.5);
+    orion_render(&o, buf, 100);
+    CHECK(buf[99 * NCH] == 10, "output is %d with a listener gain", buf[99 * NCH]);
+    orion_drop(&o);
+}
+
+/* Loads a mono sample of constant value into slot `sid` */
+static void load_sample_const(struct orion *o, int sid, int len, orion_smp val)
+{
+    orion_smp *pcm = malloc(sizeof(orion_smp) * len);
+    int i;
+    for (i = 0; i < len; ++i) pcm[i] = val;
+    orion_load_sample_raw(o, sid, 1, len, pcm);
+    orion_sample_volume(o, sid, 1);
+    free(pcm);
+}
+
+static void test_voices()
+{
+    struct orion o = orion_create(44100, NCH);
+    orion_smp buf[64 * NCH];
+    int i;
+    CHECK(orion_voice_play(&o, 0) == -1, "voice of an unloaded sample");
+
+    /* A mono sample goes to all channels and stops at its end */
+    load_sample_const(&o, 0, 50, 1000);
+    CHECK(orion_voice_play(&o, 0) >= 0, "voice not started");
+    orion_render(&o, buf, 64);
+    for (i = 0; i < 64 * NCH; ++i)
+        CHECK(buf[i] == (i < 50 * NCH ? 1000 : 0), "output[%d] is %d", i, buf[i]);
+    CHECK(o.n_active == 0, "%d active voices after the end", o.n_active);
+
+    /* Starts in the middle of a buffer */
+    orion_voice_play_at(&o, 0, o.timestamp + 10);
+    orion_render(&o, buf, 64);
+    for (i = 0; i < 64; ++i)
+        CHECK(buf[i * NCH] == (i >= 10 && i < 60 ? 1000 : 0),
+            "output[%d] is %d when starting at 10", i, buf[i * NCH]);
+
+    /* Two voices of the same sample add up; past timestamps start at once */
+    orion_voice_play_at(&o, 0, 0);
+    orion_voice_play(&o, 0);
+    orion_render(&o, buf, 64);
+    CHECK(buf[0] == 2000 && buf[50 * NCH] == 0, "output is %d, %d with two voices",
+        buf[0], buf[50 * NCH]);
+
+    /* Reloading the sample stops its voices */
+    orion_voice_play(&o, 0);
+    load_sample_const(&o, 0, 50, 500);
+    CHECK(o.n_active == 0, "%d active voices after reloading", o.n_active);
+    orion_drop(&o);
+}
+
+/* Occupies all voices with sample 0, each started a frame later than the
+ * previous one; the handles are returned */
+static void fill_voices(struct orion *o, int *h)
+{
+    int i;
+    for (i = 0; i < ORION_NUM_VOICES; ++i)
+        h[i] = orion_voice_play_at(o, 0, o->timestamp + i);
+}
+
+static void test_voice_steal()
+{
+    struct orion o = orion_create(44100, NCH);
+    orion_smp buf[64 * NCH];
+    int h[ORION_NUM_VOICES], i, n;
+    load_sample_const(&o, 0, 10000, 10);
+
+    /* The oldest voice is taken, and its old handle no longer works */
+    orion_voice_policy(&o, ORION_STEAL_OLDEST);
+    fill_voices(&o, h);
+    orion_render(&o, buf, 64);
+    CHECK(buf[63 * NCH] == 10 * ORION_NUM_VOICES, "output is %d with all voices",
+        buf[63 * NCH]);
+    n = orion_voice_play(&o, 0);
+    CHECK(n >= 0 && n % ORION_NUM_VOICES == h[0] % ORION_NUM_VOICES && n != h[0],
+        "handle %d taken, the oldest is %d", n, h[0]);
+    orion_voice_stop(&o, h[0]);
+    orion_voice_ramp(&o, h[0], 0, 0);
+    CHECK(o.n_active == ORION_NUM_VOICES, "%d active voices after a stale stop",
+        o.n_active);
+    orion_render(&o, buf, 64);
+    CHECK(buf[0] == 10 * ORION_NUM_VOICES, "output is %d after a stale ramp", buf[0]);
+    orion_voice_stop(&o, n);
+    CHECK(o.n_active == ORION_NUM_VOICES - 1, "%d active voices after stopping",
+        o.n_active);
+    for (i = 1; i < ORION_NUM_VOICES; ++i) orion_voice_stop(&o, h[i]);
+    CHECK(o.n_active == 0, "%d active voices after stopping all", o.n_active);
+
+    /* The quietest voice is taken */
+    orion_voice_policy(&o, ORION_STEAL_QUIETEST);
+    fill_voices(&o, h);
+    orion_voice_ramp(&o, h[5], 0, 0.25);
+    n = orion_voice_play(&o, 0);
+    CHECK(n % ORION_NUM_VOICES == h[5] % ORION_NUM_VOICES,
+        "handle %d taken, the quietest is %d", n, h[5]);
+    for (i = 0; i < ORION_NUM_VOICES; ++i) orion_voice_stop(&o, h[i]);
+    orion_voice_stop(&o, n);
+
+    /* No voice is taken */
+    orion_voice_policy(&o, ORION_STEAL_NONE);
+    fill_voices(&o, h);
+    CHECK(orion_voice_play(&o, 0) == -1, "a voice is taken when stealing is off");
+    orion_render(&o, buf, 64);
+    CHECK(buf[63 * NCH] == 10 * ORION_NUM_VOICES, "output is %d with all voices",
+        buf[63 * NCH]);
+    orion_drop(&o);
+}
+
+static void test_voice_ramp()
+{
+    struct orion o = orion_create(44100, NCH);
+    orion_smp buf[512 * NCH];
+    int i;
+    load_sample_const(&o, 0, 10000, 1000);
+    orion_sample_volume(&o, 0, 0.5);
+
+    /* Fades out linearly over 441 samples, across buffers */
+    int h = orion_voice_play(&o, 0);
+    orion_render(&o, buf, 100);
+    CHECK(buf[99 * NCH] == 500, "output is %d before the ramp", buf[99 * NCH]);
+    orion_voice_ramp(&o, h, 0.01, 0);
+    orion_render(&o, buf, 200);
+    orion_render(&o, buf + 200 * NCH, 312);
+    for (i = 0; i < 512; ++i) {
+        int expected = (i < 441 ? (int)lround(500 * (1 - i / 441.0)) : 0);
+        CHECK(abs(buf[i * NCH] - expected) <= 2,
+            "output[%d] is %d, expected %d", i, buf[i * NCH], expected);
+    }
+    /* The voice stays at zero volume until stopped */
+    CHECK(o.n_active == 1, "%d active voices after fading out", o.n_active);
+    orion_voice_ramp(&o, h, 0, 1);
+    orion_render(&o, buf, 64);
+    CHECK(buf[0] == 500, "output is %d after setting the volume", buf[0]);
+    orion_drop(&o);
+}
+
+/* Renders a looping sine with the given seeks, optionally compressed;
+ * the output and the data size are returned */
+static size_t render_sine(int compress, orion_smp *out, int nbuf)
+{
+    struct orion o = orion_create(44100, NCH);
+    orion_smp *pcm = malloc(sizeof(orion_smp) * 3000 * NCH);
+    int i;
+    for (i = 0; i < 3000; ++i)
+        pcm[i * NCH] = pcm[i * NCH + 1] = 8000 * sin(i * 0.0627);
+    int tid = orion_track_create(&o);
+    orion_load_raw(&o, tid, NCH, 3000, pcm);
+    free(pcm);
+    orion_ramp(&o, tid, 0, 1);
+    if (compress) orion_compress(&o, tid);
+    orion_play_loop(&o, tid, 0, 300, 2700);
+    for (i = 0; i < nbuf; ++i) {
+        memset(out + i * 100 * NCH, 0, sizeof(orion_smp) * 100 * NCH);
+        orion_render(&o, out + i * 100 * NCH, 100);
+        /* Jump around, both within and across blocks */
+        if (i % 7 == 3) orion_seek(&o, tid, i * 137);
+    }
+    size_t sz = orion_cache_usage(&o, NULL);
+    orion_drop(&o);
+    return sz;
+}
+
+static void test_compress()
+{
+    static const int NBUF = 60;
+    orion_smp raw[60 * 100 * NCH], enc[60 * 100 * NCH];
+    size_t raw_sz = render_sine(0, raw, NBUF);
+    size_t enc_sz = render_sine(1, enc, NBUF);
+    CHECK(enc_sz * 3 < raw_sz, "compressed to %zu bytes from %zu", enc_sz, raw_sz);
+    int i;
+    for (i = 0; i < NBUF * 100 * NCH; ++i)
+        CHECK(abs(raw[i] - enc[i]) < 400, "frame %d is %d, expected about %d",
+            i / NCH, enc[i], raw[i]);
+}
+
+/* Renders a whole track played once */
+static void render_track(struct orion *o, int tid, orion_smp *out, int len)
+{
+    int i;
+    orion_play_once(o, tid);
+    for (i = 0; i < len; i += 100) {
+        memset(out + i * NCH, 0, sizeof(orion_smp) * 100 * NCH);
+        orion_render(o, out + i * NCH, 100);
+    }
+    orion_pause(o, tid);
+}
+
+static void test_stretch_lazy()
+{
+    static const int LEN = 30000, OUT_LEN = 24000;
+    struct orion o = orion_create(44100, NCH);
+    orion_smp *full = malloc(sizeof(orion_smp) * OUT_LEN * NCH);
+    orion_smp *lazy = malloc(sizeof(orion_smp) * OUT_LEN * NCH);
+    int src = load_ramp(&o, LEN);
+    int sync_tid = orion_track_create(&o), lazy_tid = orion_track_create(&o);
+    orion_apply_stretch(&o, src, sync_tid, 25);
+    orion_apply_stretch_lazy(&o, src, lazy_tid, 25, 1000);
+    struct orion_stats stats;
+    int i;
+
+    /* The synchronous part is playable at once */
+    orion_play_once(&o, lazy_tid);
+    for (i = 0; i < 1000; i += 100) orion_render(&o, lazy, 100);
+    orion_pause(&o, lazy_tid);
+    orion_get_stats(&o, &stats);
+    CHECK(stats.starved == 0, "%ld buffers played ahead of the data", stats.starved);
+
+    orion_wait(&o, lazy_tid);
+    render_track(&o, sync_tid, full, OUT_LEN);
+    render_track(&o, lazy_tid, lazy, OUT_LEN);
+    for (i = 0; i < OUT_LEN * NCH; ++i)
+        CHECK(full[i] == lazy[i], "frame %d is %d, expected %d", i / NCH, lazy[i], full[i]);
+    free(full);
+    free(lazy);
+
+    /* Dropping while the rest is being produced */
+    orion_apply_stretch_lazy(&o, src, lazy_tid, -25, 0);
+    orion_drop(&o);
+}
+
+static unsigned long checksum_run()
+{
+    struct orion o = orion_create(44100, NCH);
+    orion_smp buf[100 * NCH];
+    int a = load_ramp(&o, 3000), b = load_const(&o, 500, 300);
+    orion_play_loop(&o, a, 0, 100, 2900);
+    orion_play_loop(&o, b, 0, 0, 499);
+    orion_ramp(&o, b, 0.01, 0.25);
+    orion_filter_lowpass(&o, a, 0, 2000);
+    orion_filter_lowpass(&o, a, 0.02, 8000);
+    unsigned long sum = 0;
+    int i, j;
+    for (j = 0; j < 50; ++j) {
+        orion_render(&o, buf, 100);
+        for (i = 0; i < 100 * NCH; ++i) sum = sum * 31 + (unsigned short)buf[i];
+    }
+    orion_drop(&o);
+    return sum;
+}
+
+static void test_determinism()
+{
+    unsigned long a = checksum_run(), b = checksum_run();
+    CHECK(a == b, "two identical runs differ (%lx vs %lx)", a, b);
+}
+
+static void test_file_backend()
+{
+    static const char *path = "orion_offline_test.wav";
+    struct orion o = orion_create(8000, NCH);
+    int tid = load_const(&o, 1000, 1234);
+    orion_play_loop(&o, tid, 0, 0, 999);
+    orion_set_backend(&o, &orion_backend_file, path);
+    orion_overall_play(&o);
+    SDL_Delay(20);
+    orion_overall_pause(&o);
+    long nframes = orion_overall_tell(&o);
+    orion_drop(&o);
+
+    FILE *fp = fopen(path, "rb");
+    CHECK(fp != NULL, "cannot open %s", path);
+    unsigned char hdr[44];
+    size_t nread = fread(hdr, 1, 44, fp);
+    orion_smp first[NCH];
+    size_t nfirst = fread(first, sizeof(orion_smp), NCH, fp);
+    fseek(fp, 0, SEEK_END);
+    long sz = ftell(fp);
+    fclose(fp);
+    remove(path);
+
+    CHECK(nread == 44 && memcmp(hdr, "RIFF", 4) == 0 && memcmp(hdr + 8, "WAVE", 4) == 0,
+        "bad WAV header");
+    unsigned int data_sz = hdr[40] | (hdr[41] << 8) | (hdr[42] << 16) | ((unsigned)hdr[43] << 24);
+    CHECK(nframes > 0, "nothing rendered");
+    CHECK(data_sz == nframes * NCH * sizeof(orion_smp) && sz == 44 + (long)data_sz,
+        "data size %u, file size %ld, %ld frames rendered", data_sz, sz, nframes);
+    CHECK(nfirst == NCH && first[0] == 1234, "first sample is %d", first[0]);
+}
+
+/* A backend that stops on its own can be started again */
+static void test_backend_failure()
+{
+    struct orion o = orion_create(8000, NCH);
+    orion_set_backend(&o, &orion_backend_file, "no/such/dir/orion.wav");
+    unsigned char playing;
+    orion_overall_play(&o);
+    SDL_Delay(20);
+    SDL_AtomicLock(&o.lock);
+    playing = o.is_playing;
+    SDL_AtomicUnlock(&o.lock);
+    CHECK(!playing, "still marked as playing after failing");
+    orion_set_backend(&o, &orion_backend_null, NULL);
+    orion_overall_play(&o);
+    SDL_Delay(20);
+    SDL_AtomicLock(&o.lock);
+    playing = o.is_playing;
+    SDL_AtomicUnlock(&o.lock);
+    CHECK(playing && orion_overall_tell(&o) > 0, "not restarted");
+    orion_overall_pause(&o);
+    orion_drop(&o);
+}
+
+int main()
+{
+    test_once();
+    test_loop();
+    test_tell();
+    test_tell_precise();
+    test_ramp();
+    test_schedule();
+    test_filter();
+    test_tracks();
+    test_spatial();
+    test_spatial_none();
+    test_voices();
+    test_voice_steal();
+    test_voice_ramp();
+    test_compress();
+    test_stretch_lazy();
+    test_determinism();
+    test_file_backend();
+    test_backend_failure();
+    if (failures == 0) puts("All tests passed");
+    return failures != 0;
+}
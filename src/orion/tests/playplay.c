@@ -7,44 +7,47 @@
 int main()
 {
     struct orion o = orion_create(44100, 2);
-    const char *msg = orion_load_ogg(&o, 0, "sketchch.ogg");
+    int tids[2];
+    tids[0] = orion_track_create(&o);
+    tids[1] = orion_track_create(&o);
+    const char *msg = orion_load_ogg(&o, tids[0], "sketchch.ogg");
     if (msg != NULL) {
         puts(msg);
         return 1;
     }
 
-    orion_apply_lowpass(&o, 0, 1, 880);
+    orion_apply_lowpass(&o, tids[0], tids[1], 880);
 
     orion_overall_play(&o);
-    orion_play_once(&o, 0);
-    orion_play_once(&o, 1);
-    orion_ramp(&o, 1, 0.0, 0.0);
+    orion_play_once(&o, tids[0]);
+    orion_play_once(&o, tids[1]);
+    orion_ramp(&o, tids[1], 0.0, 0.0);
     sleep(12.0 / 3);
-    orion_ramp(&o, 0, 0.3, 0.0);
-    orion_ramp(&o, 1, 0.3, 1.0);
+    orion_ramp(&o, tids[0], 0.3, 0.0);
+    orion_ramp(&o, tids[1], 0.3, 1.0);
     sleep(12.0 / 3);
-    orion_pause(&o, 0);
-    orion_pause(&o, 1);
+    orion_pause(&o, tids[0]);
+    orion_pause(&o, tids[1]);
     orion_overall_pause(&o);
 
     int i;
     for (i = 0; i <= 1; ++i) {
         orion_overall_play(&o);
         if (i == 0) {
-            orion_play_once(&o, i);
+            orion_play_once(&o, tids[i]);
             sleep(2);
-            orion_ramp(&o, i, 1.0, 0.5);
+            orion_ramp(&o, tids[i], 1.0, 0.5);
             sleep(2);
-            orion_seek(&o, i, -44100 * 3);
+            orion_seek(&o, tids[i], -44100 * 3);
             sleep(2);
-            printf("%d\n", orion_tell(&o, i));
+            printf("%d\n", orion_tell(&o, tids[i]));
             sleep(2);
-            printf("%d\n", orion_tell(&o, i));
+            printf("%d\n", orion_tell(&o, tids[i]));
         } else {
-            orion_play_loop(&o, i, 0, 44100, 88200);
+            orion_play_loop(&o, tids[i], 0, 44100, 88200);
             sleep(5);
         }
-        orion_pause(&o, i);
+        orion_pause(&o, tids[i]);
         orion_overall_pause(&o);
         sleep(1);
     }
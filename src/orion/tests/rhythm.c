@@ -6,21 +6,22 @@
 int main()
 {
     struct orion o = orion_create(44100, 2);
-    const char *msg = orion_load_ogg(&o, 0, "sketchch.ogg");
+    int tid = orion_track_create(&o);
+    const char *msg = orion_load_ogg(&o, tid, "sketchch.ogg");
     if (msg != NULL) {
         puts(msg);
         return 1;
     }
 
     orion_overall_play(&o);
-    orion_play_loop(&o, 0, 0, 0, -1);
+    orion_play_loop(&o, tid, 0, 0, -1);
 
     double beat = 1.0 / 3;
     double resolution = 50;
     printf("Resolution: %.1lf ms\n", beat / (resolution * 2) * 1000);
 
     while (getchar() == '\n') {
-        double time = orion_tell(&o, 0) / 44100.0;
+        double time = orion_tell(&o, tid) / 44100.0;
         double t1 = fmod(time, beat), t2 = beat - t1;
         if (t1 > t2) t1 = -t2;
         int x = (int)(t1 / beat * (resolution * 2) + 0.5);
@@ -6,31 +6,39 @@
 int main()
 {
     struct orion o = orion_create(44100, 2);
-    const char *msg = orion_load_ogg(&o, 0, "sketchch.ogg");
+    int tids[3], i;
+    for (i = 0; i < 3; ++i) tids[i] = orion_track_create(&o);
+    const char *msg = orion_load_ogg(&o, tids[0], "sketchch.ogg");
     if (msg != NULL) {
         puts(msg);
         return 1;
     }
 
-    orion_apply_lowpass(&o, 0, 1, 880);
-    orion_apply_stretch(&o, 0, 2, -20);
+    orion_apply_lowpass(&o, tids[0], tids[1], 880);
+    orion_apply_stretch(&o, tids[0], tids[2], -20);
 
     while (1) {
-        int a = rand() % 9;
+        int a = rand() % 10;
         printf("%d\n", a);
         switch (a) {
             case 0: orion_overall_play(&o); break;
             case 1: orion_overall_pause(&o); break;
-            case 2: orion_play_once(&o, rand() % 3); break;
-            case 3: orion_play_loop(&o, rand() % 3, rand(), rand(), rand()); break;
-            case 4: orion_play_loop(&o, rand() % 3, rand(), rand(), -1); break;
-            case 5: orion_pause(&o, rand() % 3); break;
-            case 6: orion_resume(&o, rand() % 3); break;
-            case 7: orion_seek(&o, rand() % 3, rand()); break;
+            case 2: orion_play_once(&o, tids[rand() % 3]); break;
+            case 3: orion_play_loop(&o, tids[rand() % 3], rand(), rand(), rand()); break;
+            case 4: orion_play_loop(&o, tids[rand() % 3], rand(), rand(), -1); break;
+            case 5: orion_pause(&o, tids[rand() % 3]); break;
+            case 6: orion_resume(&o, tids[rand() % 3]); break;
+            case 7: orion_seek(&o, tids[rand() % 3], rand()); break;
             case 8:
-                orion_ramp(&o, rand() % 3,
+                orion_ramp(&o, tids[rand() % 3],
                     (double)rand() / RAND_MAX, (double)rand() / RAND_MAX);
                 break;
+            case 9:
+                i = rand() % 3;
+                orion_track_drop(&o, tids[i], (double)rand() / RAND_MAX);
+                tids[i] = orion_track_create(&o);
+                orion_share(&o, tids[(i + 1) % 3], tids[i]);
+                break;
         }
     }
 
@@ -12,6 +12,8 @@
 #define min(_a, _b) ((_a) < (_b) ? (_a) : (_b))
 
 static const int PIX_PER_UNIT = 2;
+/* Least width of the texture holding a chapter's minimaps */
+static const int MINIMAP_PAGE_W = 1024;
 static const double CAM_MOV_FAC = 8;
 static const double NAV_W = WIN_W * 0.8;
 static const double NAV_H = WIN_H * 0.9;
@@ -104,12 +106,13 @@ static void ow_tick(overworld_scene *this, double dt)
 }
 
 static inline void draw_stage(overworld_scene *this,
-    struct chap_rec *ch, SDL_Texture **tex, int opacity, int i)
+    struct chap_rec *ch, texture *tex, int opacity, int i)
 {
     int c = (i > this->cleared_stages ? 48 : (i == this->cur_stage_idx) ? 255 : 144);
-    SDL_SetTextureColorMod(tex[i], c, c, c);
-    SDL_SetTextureAlphaMod(tex[i], opacity);
-    SDL_RenderCopy(g_renderer, tex[i], NULL, &(SDL_Rect){
+    /* Modulation is taken at each copy, so stages can share the texture */
+    SDL_SetTextureColorMod(tex[i].sdl_tex, c, c, c);
+    SDL_SetTextureAlphaMod(tex[i].sdl_tex, opacity);
+    SDL_RenderCopy(g_renderer, tex[i].sdl_tex, &tex[i].range, &(SDL_Rect){
         ((ch->stages[i]->world_c + ch->stages[i]->cam_c1) * PIX_PER_UNIT - this->cam_x) * this->cam_scale + WIN_W / 2,
         ((ch->stages[i]->world_r + ch->stages[i]->cam_r1) * PIX_PER_UNIT - this->cam_y) * this->cam_scale + WIN_H / 2,
         (ch->stages[i]->cam_c2 - ch->stages[i]->cam_c1) * PIX_PER_UNIT * this->cam_scale,
@@ -132,7 +135,7 @@ static void ow_draw(overworld_scene *this)
 
     int i;
     struct chap_rec *ch = bekter_at(this->chaps, this->cur_chap_idx, struct chap_rec *);
-    SDL_Texture **tex = bekter_at(this->stage_tex, this->cur_chap_idx, SDL_Texture **);
+    texture *tex = bekter_at(this->stage_tex, this->cur_chap_idx, texture *);
 
     int opacity = 255;
     if (this->since_chap_switch <= CHAP_SW_DUR) {
@@ -140,7 +143,7 @@ static void ow_draw(overworld_scene *this)
         opacity = 0;
         if (r < 0.5) {
             ch = bekter_at(this->chaps, this->last_chap_idx, struct chap_rec *);
-            tex = bekter_at(this->stage_tex, this->last_chap_idx, SDL_Texture **);
+            tex = bekter_at(this->stage_tex, this->last_chap_idx, texture *);
             if (r < 1.0 / 3) opacity = iround(255 * (1 - r * 3));
         } else if (r >= 2.0 / 3) {
             opacity = iround(255 * (r * 3 - 2));
@@ -165,12 +168,12 @@ static void ow_drop(overworld_scene *this)
 {
     floue_drop(this->f);
 
-    int i, j;
+    int i;
 
-    SDL_Texture **q;
+    texture *q;
     for bekter_each(this->stage_tex, i, q) {
-        int n = bekter_at(this->chaps, i / sizeof(struct chap_rec *), struct chap_rec *)->n_stages;
-        for (j = 0; j < n; ++j) SDL_DestroyTexture(q[j]);
+        /* Stages of a chapter share one texture */
+        SDL_DestroyTexture(q[0].sdl_tex);
         free(q);
     }
     bekter_drop(this->stage_tex);
@@ -197,20 +200,20 @@ static void ow_key(overworld_scene *this, SDL_KeyboardEvent *ev)
         case SDLK_c:
         case SDLK_z:
             g_stage = (scene *)overworld_menu_create(this);
-            orion_play_once(&g_orion, TRACKID_MENU_OPEN);
+            orion_voice_play(&g_orion, SFXID_MENU_OPEN);
             break;
         case SDLK_LEFT:
             if (this->cur_stage_idx > 0) {
                 this->cur_stage_idx--;
                 move_camera(this);
-                orion_play_once(&g_orion, TRACKID_FX_SW1);
+                orion_voice_play(&g_orion, SFXID_SW1);
             }
             break;
         case SDLK_RIGHT:
             if (this->cur_stage_idx < this->cleared_stages) {
                 this->cur_stage_idx++;
                 move_camera(this);
-                orion_play_once(&g_orion, TRACKID_FX_SW1);
+                orion_voice_play(&g_orion, SFXID_SW1);
             }
             break;
         case SDLK_UP:
@@ -221,7 +224,7 @@ static void ow_key(overworld_scene *this, SDL_KeyboardEvent *ev)
                 this->cur_stage_idx = min(this->cur_stage_idx, this->cleared_stages);
                 move_camera(this);
                 this->since_chap_switch = 0;
-                orion_play_once(&g_orion, TRACKID_FX_SW1);
+                orion_voice_play(&g_orion, SFXID_SW1);
             }
             break;
         case SDLK_DOWN:
@@ -232,55 +235,12 @@ static void ow_key(overworld_scene *this, SDL_KeyboardEvent *ev)
                 this->cur_stage_idx = min(this->cur_stage_idx, this->cleared_stages);
                 move_camera(this);
                 this->since_chap_switch = 0;
-                orion_play_once(&g_orion, TRACKID_FX_SW1);
+                orion_voice_play(&g_orion, SFXID_SW1);
             }
             break;
     }
 }
 
-#define SAMPLER_TEX_SZ 16
-#define PITCH (SAMPLER_TEX_SZ * 4)
-
-static inline Uint32 weighted_average(Uint32 *buf, int r0, int c0)
-{
-    int i1, j1, i2, j2;
-    Uint64 raw_a = 0, ct = 0, rs = 0, gs = 0, bs = 0;
-    for (i1 = r0; i1 < r0 + SAMPLER_TEX_SZ / 2; ++i1)
-    for (j1 = c0; j1 < c0 + SAMPLER_TEX_SZ / 2; ++j1) {
-        int r = (buf[i1 * SAMPLER_TEX_SZ + j1] >> 24),
-            g = (buf[i1 * SAMPLER_TEX_SZ + j1] >> 16) & 0xff,
-            b = (buf[i1 * SAMPLER_TEX_SZ + j1] >> 8) & 0xff,
-            a = (buf[i1 * SAMPLER_TEX_SZ + j1]) & 0xff;
-        if (a == 0) continue;
-        raw_a += a;
-        for (i2 = r0; i2 < r0 + SAMPLER_TEX_SZ / 2; ++i2)
-        for (j2 = c0; j2 < c0 + SAMPLER_TEX_SZ / 2; ++j2)
-            if (buf[i1 * SAMPLER_TEX_SZ + j1] == buf[i2 * SAMPLER_TEX_SZ + j2]) {
-                ct += a;
-                rs += r * a;
-                gs += g * a;
-                bs += b * a;
-            }
-    }
-    if (raw_a == 0) return 0;
-    return (iround((double)rs / ct) << 24) |
-        (iround((double)gs / ct) << 16) |
-        (iround((double)bs / ct) << 8) |
-        (iround((double)raw_a / (SAMPLER_TEX_SZ * SAMPLER_TEX_SZ / 4)));
-}
-
-static inline void retrieve_colour(Uint32 *buf, const texture tex, Uint32 out[4])
-{
-    if (tex.sdl_tex == NULL) return;
-    SDL_RenderClear(g_renderer);
-    render_texture(tex, NULL);
-    SDL_RenderReadPixels(g_renderer, NULL, SDL_PIXELFORMAT_RGBA8888, buf, PITCH);
-    out[0] = weighted_average(buf, 0, 0);
-    out[1] = weighted_average(buf, 0, SAMPLER_TEX_SZ / 2);
-    out[2] = weighted_average(buf, SAMPLER_TEX_SZ / 2, 0);
-    out[3] = weighted_average(buf, SAMPLER_TEX_SZ / 2, SAMPLER_TEX_SZ / 2);
-}
-
 static inline Uint32 manipulate(Uint32 colour, int r, int c)
 {
     if ((colour & 0xff) == 0) return colour;
@@ -297,56 +257,63 @@ static inline void load_chapter(overworld_scene *this, const char *path)
     bekter_pushback(this->chaps, ch);
     this->n_chaps++;
 
-    SDL_SetHint(SDL_HINT_RENDER_SCALE_QUALITY, "0");
-    SDL_Texture **tex_arr = malloc(sizeof(SDL_Texture *) * ch->n_stages);
-
+    /* Minimaps of all stages are packed into one texture, in shelves */
+    texture *tex_arr = malloc(sizeof(texture) * ch->n_stages);
     int i, r, c;
-    Uint32 repr_colour[256][4] = {{ 0 }};
-    SDL_Texture *tmp_tex = SDL_CreateTexture(
-        g_renderer, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_TARGET,
-        SAMPLER_TEX_SZ, SAMPLER_TEX_SZ);
-    SDL_SetRenderTarget(g_renderer, tmp_tex);
-    SDL_SetRenderDrawBlendMode(g_renderer, SDL_BLENDMODE_BLEND);
-    SDL_SetRenderDrawColor(g_renderer, 0, 0, 0, 0);
-    Uint32 *buf = malloc(SAMPLER_TEX_SZ * PITCH);
-    for (i = 0; i < 256; ++i)
-        retrieve_colour(buf, ch->stages[0]->grid_tex[i], repr_colour[i]);
-    SDL_SetRenderTarget(g_renderer, NULL);
-    SDL_DestroyTexture(tmp_tex);
-    free(buf);
+    int x = 0, y = 0, shelf_h = 0, tex_w = MINIMAP_PAGE_W;
+    for (i = 0; i < ch->n_stages; ++i) {
+        struct stage_rec *st = ch->stages[i];
+        int w = (st->cam_c2 - st->cam_c1) * PIX_PER_UNIT;
+        if (tex_w < w) tex_w = w;
+    }
+    for (i = 0; i < ch->n_stages; ++i) {
+        struct stage_rec *st = ch->stages[i];
+        int w = (st->cam_c2 - st->cam_c1) * PIX_PER_UNIT,
+            h = (st->cam_r2 - st->cam_r1) * PIX_PER_UNIT;
+        if (x + w > tex_w) {
+            x = 0;
+            y += shelf_h + 1;
+            shelf_h = 0;
+        }
+        tex_arr[i] = (texture){NULL, (SDL_Rect){x, y, w, h}};
+        x += w + 1;
+        if (shelf_h < h) shelf_h = h;
+    }
+    int tex_h = y + shelf_h;
+    if (tex_h == 0) tex_h = 1;
 
+    Uint32 *pix = calloc((size_t)tex_w * tex_h, 4);
     for (i = 0; i < ch->n_stages; ++i) {
         struct stage_rec *st = ch->stages[i];
         int nr = st->cam_r2 - st->cam_r1,
             nc = st->cam_c2 - st->cam_c1;
-        int h = nr * PIX_PER_UNIT, w = nc * PIX_PER_UNIT;
-        SDL_Texture *tex = SDL_CreateTexture(
-            g_renderer, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_STATIC, w, h
-        );
-        SDL_SetTextureBlendMode(tex, SDL_BLENDMODE_BLEND);
-        Uint32 *pix = malloc(w * h * 4);
-        memset(pix, 0, w * h * 4);
+        Uint32 *p = pix + tex_arr[i].range.y * tex_w + tex_arr[i].range.x;
         for (r = 0; r < nr; ++r)
             for (c = 0; c < nc; ++c) {
-                Uint32 *cell = repr_colour[
+                const Uint32 *cell = grid_colours(
                     st->grid[(r + st->cam_r1) * st->n_cols + (c + st->cam_c1)]
-                ];
-                pix[(r * 2) * w + (c * 2)] = manipulate(cell[0],
+                );
+                p[(r * 2) * tex_w + (c * 2)] = manipulate(cell[0],
                     r + st->world_r + st->cam_r1, c + st->world_c + st->cam_c1);
-                pix[(r * 2) * w + (c * 2 + 1)] = manipulate(cell[1],
+                p[(r * 2) * tex_w + (c * 2 + 1)] = manipulate(cell[1],
                     r + st->world_r + st->cam_r1, c + st->world_c + st->cam_c1 + 256);
-                pix[(r * 2 + 1) * w + (c * 2)] = manipulate(cell[2],
+                p[(r * 2 + 1) * tex_w + (c * 2)] = manipulate(cell[2],
                     r + st->world_r + st->cam_r1 + 256, c + st->world_c + st->cam_c1);
-                pix[(r * 2 + 1) * w + (c * 2 + 1)] = manipulate(cell[3],
+                p[(r * 2 + 1) * tex_w + (c * 2 + 1)] = manipulate(cell[3],
                     r + st->world_r + st->cam_r1 + 256, c + st->world_c + st->cam_c1 + 256);
             }
-        SDL_UpdateTexture(tex, NULL, pix, w * 4);
-        free(pix);
-        tex_arr[i] = tex;
     }
 
-    bekter_pushback(this->stage_tex, tex_arr);
+    SDL_SetHint(SDL_HINT_RENDER_SCALE_QUALITY, "0");
+    SDL_Texture *tex = SDL_CreateTexture(g_renderer,
+        SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_STATIC, tex_w, tex_h);
     SDL_SetHint(SDL_HINT_RENDER_SCALE_QUALITY, "1");
+    SDL_SetTextureBlendMode(tex, SDL_BLENDMODE_BLEND);
+    SDL_UpdateTexture(tex, NULL, pix, tex_w * 4);
+    free(pix);
+    for (i = 0; i < ch->n_stages; ++i) tex_arr[i].sdl_tex = tex;
+
+    bekter_pushback(this->stage_tex, tex_arr);
 }
 
 overworld_scene *overworld_create(scene *bg)
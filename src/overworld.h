@@ -19,7 +19,9 @@ typedef struct _overworld_scene {
     int n_chaps, cur_chap_idx;
     int cleared_chaps;  /* Index of the latest chapter reachable */
 
-    bekter(SDL_Texture **) stage_tex;
+    /* Minimaps, one list for each chapter; those in a chapter
+     * are parts of the same texture */
+    bekter(texture *) stage_tex;
     int cur_stage_idx;
     /* Index of the latest stage reachable, in _current selected character_ */
     int cleared_stages;
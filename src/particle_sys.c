@@ -1,18 +1,77 @@
 #include "particle_sys.h"
 #include "global.h"
+#include "batch.h"
 
 #include <math.h>
-#include <stdlib.h>
-#include <string.h>
+
+#ifdef __SSE__
+#include <xmmintrin.h>
+#endif
+
+#define MASK    (PARTICLE_CAP - 1)
+/* Number of entries in the sine table, covering a full circle */
+#define SINE_N  1024
+
+static const float DRAG = 3;
+static const float WANDER = 15 * SINE_N / (2 * M_PI);
+static const float ACCEL = 10;
+
+static float sine[SINE_N];
 
 void particle_init(particle_sys *sys)
 {
-    sys->sz = 0;
+    sys->head = sys->sz = 0;
+    sys->seed = 2463534242u;
+    if (sine[SINE_N / 4] == 0) {
+        int i;
+        for (i = 0; i < SINE_N; ++i) sine[i] = sin(M_PI * 2 * i / SINE_N);
+    }
+}
+
+/* Xorshift; cheaper than rand() and local to the system */
+static inline float rand_in(particle_sys *sys, float a, float b)
+{
+    Uint32 x = sys->seed;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    sys->seed = x;
+    return (float)(x >> 8) / (1 << 24) * (b - a) + a;
+}
+
+static inline float sine_at(float a)
+{
+    return sine[(int)a & (SINE_N - 1)];
+}
+
+static inline float cosine_at(float a)
+{
+    return sine[((int)a + SINE_N / 4) & (SINE_N - 1)];
 }
 
-static inline double rand_in(double a, double b)
+/* Moves live particles towards the head, keeping their order,
+ * so that slots held by expired ones are freed */
+static void compact(particle_sys *sys)
 {
-    return (double)rand() / RAND_MAX * (b - a) + a;
+    int k, n = 0;
+    for (k = 0; k < sys->sz; ++k) {
+        int i = (sys->head + k) & MASK;
+        if (sys->life[i] <= 0) continue;
+        if (n != k) {
+            int j = (sys->head + n) & MASK;
+            sys->x[j] = sys->x[i];
+            sys->y[j] = sys->y[i];
+            sys->vx[j] = sys->vx[i];
+            sys->vy[j] = sys->vy[i];
+            sys->angle[j] = sys->angle[i];
+            sys->life[j] = sys->life[i];
+            sys->w[j] = sys->w[i];
+            sys->h[j] = sys->h[i];
+            sys->c[j] = sys->c[i];
+        }
+        ++n;
+    }
+    sys->sz = n;
 }
 
 void particle_add(particle_sys *sys,
@@ -20,58 +79,90 @@ void particle_add(particle_sys *sys,
     double tmin, double tmax,
     unsigned char r, unsigned char g, unsigned char b)
 {
-    /* TODO: Eliminate earliest particles in the pool */
-    if (sys->sz >= PARTICLE_CAP) return;
-    particle p;
-    p.x = x;
-    p.y = y;
-    p.vx = vx;
-    p.vy = vy;
-    p.drag = 3;
-    p.angle = rand_in(-M_PI, +M_PI);
-    p.wander = 15;
-    p.w = w;
-    p.h = h;
-    p.life = rand_in(tmin, tmax);
-    p.r = r;
-    p.g = g;
-    p.b = b;
-    sys->pool[sys->sz++] = p;
+    int i;
+    if (sys->sz == PARTICLE_CAP) compact(sys);
+    if (sys->sz == PARTICLE_CAP) {
+        /* All alive; replace the oldest one */
+        i = sys->head;
+        sys->head = (sys->head + 1) & MASK;
+    } else {
+        i = (sys->head + sys->sz++) & MASK;
+    }
+    sys->x[i] = x;
+    sys->y[i] = y;
+    sys->vx[i] = vx;
+    sys->vy[i] = vy;
+    sys->angle[i] = rand_in(sys, -SINE_N / 2, +SINE_N / 2);
+    sys->w[i] = w;
+    sys->h[i] = h;
+    sys->life[i] = rand_in(sys, tmin, tmax);
+    sys->c[i] = (SDL_Color){r, g, b, 255};
+}
+
+/* Updates the particles in [from, to) of the buffer */
+static inline void tick_range(particle_sys *sys, int from, int to, float dt)
+{
+    int i;
+    /* Random numbers are generated in sequence */
+    for (i = from; i < to; ++i) {
+        sys->angle[i] += rand_in(sys, -1, +1) * WANDER * dt;
+        sys->ax[i] = cosine_at(sys->angle[i]) * ACCEL * dt;
+        sys->ay[i] = sine_at(sys->angle[i]) * ACCEL * dt;
+    }
+    /* Particles are independent here; four are updated at a time */
+    float damp = 1 - DRAG * dt;
+    i = from;
+#ifdef __SSE__
+    __m128 vdt = _mm_set1_ps(dt), vdamp = _mm_set1_ps(damp);
+    for (; i + 4 <= to; i += 4) {
+        __m128 vx = _mm_loadu_ps(sys->vx + i), vy = _mm_loadu_ps(sys->vy + i);
+        _mm_storeu_ps(sys->life + i,
+            _mm_sub_ps(_mm_loadu_ps(sys->life + i), vdt));
+        _mm_storeu_ps(sys->x + i,
+            _mm_add_ps(_mm_loadu_ps(sys->x + i), _mm_mul_ps(vx, vdt)));
+        _mm_storeu_ps(sys->y + i,
+            _mm_add_ps(_mm_loadu_ps(sys->y + i), _mm_mul_ps(vy, vdt)));
+        _mm_storeu_ps(sys->vx + i,
+            _mm_add_ps(_mm_mul_ps(vx, vdamp), _mm_loadu_ps(sys->ax + i)));
+        _mm_storeu_ps(sys->vy + i,
+            _mm_add_ps(_mm_mul_ps(vy, vdamp), _mm_loadu_ps(sys->ay + i)));
+    }
+#endif
+    for (; i < to; ++i) {
+        sys->life[i] -= dt;
+        sys->x[i] += sys->vx[i] * dt;
+        sys->y[i] += sys->vy[i] * dt;
+        sys->vx[i] = sys->vx[i] * damp + sys->ax[i];
+        sys->vy[i] = sys->vy[i] * damp + sys->ay[i];
+    }
 }
 
 void particle_tick(particle_sys *sys, double dt)
 {
-    int i, n = sys->sz;
-    for (i = 0; i < n; ++i) {
-        particle *p = &sys->pool[i];
-        if ((p->life -= dt) <= 0) {
-            *p = sys->pool[--n];
-            --i;
-            continue;
-        }
-        p->x += p->vx * dt;
-        p->y += p->vy * dt;
-        p->vx *= (1 - p->drag * dt);
-        p->vy *= (1 - p->drag * dt);
-        p->angle += rand_in(-1, +1) * p->wander * dt;
-        p->vx += cos(p->angle) * 10 * dt;
-        p->vy += sin(p->angle) * 10 * dt;
+    int end = sys->head + sys->sz;
+    tick_range(sys, sys->head, end < PARTICLE_CAP ? end : PARTICLE_CAP, dt);
+    if (end > PARTICLE_CAP) tick_range(sys, 0, end - PARTICLE_CAP, dt);
+    /* Expired particles elsewhere are skipped, and their slots
+     * are reclaimed when the buffer is full */
+    while (sys->sz > 0 && sys->life[sys->head] <= 0) {
+        sys->head = (sys->head + 1) & MASK;
+        --sys->sz;
     }
-    sys->sz = n;
 }
 
 void particle_draw_aligned(particle_sys *sys,
     int xoffs, int yoffs, int align)
 {
-    int i, n = sys->sz;
-    for (i = 0; i < n; ++i) {
-        particle p = sys->pool[i];
+    int k;
+    for (k = 0; k < sys->sz; ++k) {
+        int i = (sys->head + k) & MASK;
+        if (sys->life[i] <= 0) continue;
         SDL_Rect r;
-        r.x = iround((p.x + xoffs) / align) * align;
-        r.y = iround((p.y + yoffs) / align) * align;
-        r.w = p.w;
-        r.h = p.h;
-        SDL_SetRenderDrawColor(g_renderer, p.r, p.g, p.b, 255);
-        SDL_RenderFillRect(g_renderer, &r);
+        r.x = iround((sys->x[i] + xoffs) / align) * align;
+        r.y = iround((sys->y[i] + yoffs) / align) * align;
+        r.w = sys->w[i];
+        r.h = sys->h[i];
+        batch_fill(&r, sys->c[i]);
     }
+    batch_flush();
 }
@@ -6,18 +6,22 @@
 
 #include <SDL.h>
 
-typedef struct _particle {
-    double x, y, vx, vy, drag;
-    double angle, wander;
-    int w, h;
-    double life;
-    unsigned char r, g, b;
-} particle;
-
+/* Should be a power of 2 */
 #define PARTICLE_CAP 1024
+/* Particles are kept in a ring buffer in order of creation;
+ * when it's full, slots of expired ones are reclaimed first,
+ * then the oldest ones are replaced.
+ * Fields are stored in separate arrays to be updated in bulk. */
 typedef struct _particle_sys {
-    int sz;
-    particle pool[PARTICLE_CAP];
+    int head, sz;
+    Uint32 seed;    /* State of the random number generator */
+    float x[PARTICLE_CAP], y[PARTICLE_CAP];
+    float vx[PARTICLE_CAP], vy[PARTICLE_CAP];
+    float ax[PARTICLE_CAP], ay[PARTICLE_CAP];
+    float angle[PARTICLE_CAP];  /* In entries of the sine table */
+    float life[PARTICLE_CAP];
+    int w[PARTICLE_CAP], h[PARTICLE_CAP];
+    SDL_Color c[PARTICLE_CAP];
 } particle_sys;
 
 void particle_init(particle_sys *sys);
@@ -123,14 +123,14 @@ static inline void pause_key_handler(pause_scene *this, SDL_KeyboardEvent *ev)
             this->last_menu_idx = this->menu_idx;
             this->menu_idx = (this->menu_idx - 1 + N_MENU) % N_MENU;
             this->menu_time = this->time;
-            orion_play_once(&g_orion, TRACKID_FX_SW1);
+            orion_voice_play(&g_orion, SFXID_SW1);
             break;
         case SDLK_DOWN:
         case SDLK_RIGHT:
             this->last_menu_idx = this->menu_idx;
             this->menu_idx = (this->menu_idx + 1) % N_MENU;
             this->menu_time = this->time;
-            orion_play_once(&g_orion, TRACKID_FX_SW1);
+            orion_voice_play(&g_orion, SFXID_SW1);
             break;
     }
 }
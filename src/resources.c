@@ -5,15 +5,19 @@
 #include <SDL_ttf.h>
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 #define RES_HASH_SZ 997
 #define GRID_SZ 256
+/* Cells are sampled as if stretched to this size for colours */
+#define REPR_SZ 16
 
 static bekter(SDL_Texture *) sdl_tex_list;
 static bekter(_texture_kvpair) res_map[RES_HASH_SZ];
 static texture grid[GRID_SZ];
 static int grid_tx[GRID_SZ], grid_ty[GRID_SZ];
+static Uint32 grid_repr[GRID_SZ][4];
 
 static unsigned int elf_hash(const char *s)
 {
@@ -28,14 +32,20 @@ static unsigned int elf_hash(const char *s)
     return (h & 0x7fffffff);
 }
 
+static SDL_Texture *texture_from_surface(SDL_Surface *sfc, int *w, int *h)
+{
+    SDL_Texture *tex = SDL_CreateTextureFromSurface(g_renderer, sfc);
+    SDL_QueryTexture(tex, NULL, NULL, w, h);
+    bekter_pushback(sdl_tex_list, tex);
+    return tex;
+}
+
 static SDL_Texture *texture_from_file(const char *path, int *w, int *h)
 {
     SDL_Surface *sfc = IMG_Load(path);
     if (sfc == NULL) return NULL;
-    SDL_Texture *tex = SDL_CreateTextureFromSurface(g_renderer, sfc);
+    SDL_Texture *tex = texture_from_surface(sfc, w, h);
     SDL_FreeSurface(sfc);
-    SDL_QueryTexture(tex, NULL, NULL, w, h);
-    bekter_pushback(sdl_tex_list, tex);
     return tex;
 }
 
@@ -54,13 +64,83 @@ static void load_image(const char *path)
     bekter_pushback(res_map[hash], p);
 }
 
+static int cmp_colour(const void *a, const void *b)
+{
+    Uint32 x = *(const Uint32 *)a, y = *(const Uint32 *)b;
+    return x < y ? -1 : x > y;
+}
+
+/* Average of the visible pixels, each distinct colour weighted by
+ * its alpha and the square of its count so that dominant ones prevail;
+ * alpha is averaged over all pixels. Reorders `pix` */
+static Uint32 dominant_colour(Uint32 *pix, int n)
+{
+    Uint64 raw_a = 0, ct = 0, rs = 0, gs = 0, bs = 0;
+    int i, j;
+    /* Identical colours become runs */
+    qsort(pix, n, sizeof(Uint32), cmp_colour);
+    for (i = 0; i < n; i = j) {
+        for (j = i + 1; j < n && pix[j] == pix[i]; ++j) ;
+        Uint64 a = pix[i] & 0xff, w = a * (j - i) * (j - i);
+        if (a == 0) continue;
+        raw_a += a * (j - i);
+        ct += w;
+        rs += (pix[i] >> 24) * w;
+        gs += ((pix[i] >> 16) & 0xff) * w;
+        bs += ((pix[i] >> 8) & 0xff) * w;
+    }
+    if (raw_a == 0) return 0;
+    return ((Uint32)iround((double)rs / ct) << 24) |
+        (iround((double)gs / ct) << 16) |
+        (iround((double)bs / ct) << 8) |
+        (iround((double)raw_a / n));
+}
+
+/* Finds colours of the four quarters of each cell, for minimaps */
+static void calc_grid_colours(SDL_Surface *sfc)
+{
+    SDL_Surface *conv =
+        SDL_ConvertSurfaceFormat(sfc, SDL_PIXELFORMAT_RGBA8888, 0);
+    if (conv == NULL) return;
+    if (SDL_MUSTLOCK(conv)) SDL_LockSurface(conv);
+
+    Uint32 quarter[4][REPR_SZ * REPR_SZ / 4];
+    int i, r, c, q;
+    for (i = 1; i < GRID_SZ; ++i) {
+        SDL_Rect *rg = &grid[i].range;
+        if (rg->w <= 0 || rg->h <= 0 ||
+            rg->x + rg->w > conv->w || rg->y + rg->h > conv->h)
+        {
+            continue;
+        }
+        int n[4] = { 0 };
+        for (r = 0; r < REPR_SZ; ++r)
+            for (c = 0; c < REPR_SZ; ++c) {
+                int x = rg->x + c * rg->w / REPR_SZ,
+                    y = rg->y + r * rg->h / REPR_SZ;
+                q = (r >= REPR_SZ / 2) * 2 + (c >= REPR_SZ / 2);
+                quarter[q][n[q]++] =
+                    *((Uint32 *)((Uint8 *)conv->pixels + y * conv->pitch) + x);
+            }
+        for (q = 0; q < 4; ++q)
+            grid_repr[i][q] = dominant_colour(quarter[q], n[q]);
+    }
+
+    if (SDL_MUSTLOCK(conv)) SDL_UnlockSurface(conv);
+    SDL_FreeSurface(conv);
+}
+
 static void load_grid(const char *image, const char *csv)
 {
-    SDL_Texture *tex = texture_from_file(image, NULL, NULL);
-    if (tex == NULL) return;
+    SDL_Surface *sfc = IMG_Load(image);
+    if (sfc == NULL) return;
+    SDL_Texture *tex = texture_from_surface(sfc, NULL, NULL);
 
     FILE *f = fopen(csv, "r");
-    if (f == NULL) return;
+    if (f == NULL) {
+        SDL_FreeSurface(sfc);
+        return;
+    }
 
     int i;
     for (i = 1; i < GRID_SZ; ++i) {
@@ -72,6 +152,9 @@ static void load_grid(const char *image, const char *csv)
         grid_ty[i] = ty;
     }
     fclose(f);
+
+    calc_grid_colours(sfc);
+    SDL_FreeSurface(sfc);
 }
 
 static void load_spritesheet(const char *image, const char *csv)
@@ -153,6 +236,11 @@ void grid_offset(unsigned char idx, int *x, int *y)
     *y = grid_ty[idx];
 }
 
+const Uint32 *grid_colours(unsigned char idx)
+{
+    return grid_repr[idx];
+}
+
 texture temp_texture(SDL_Texture *sdl_tex)
 {
     texture ret;
@@ -189,6 +277,16 @@ void render_texture_alpha(texture t, SDL_Rect *dim, int alpha)
     SDL_SetTextureAlphaMod(t.sdl_tex, 255);
 }
 
+void set_premultiplied(SDL_Texture *tex)
+{
+    SDL_BlendMode mode = SDL_ComposeCustomBlendMode(
+        SDL_BLENDFACTOR_ONE, SDL_BLENDFACTOR_ONE_MINUS_SRC_ALPHA, SDL_BLENDOPERATION_ADD,
+        SDL_BLENDFACTOR_ONE, SDL_BLENDFACTOR_ONE_MINUS_SRC_ALPHA, SDL_BLENDOPERATION_ADD);
+    /* Not all renderers support custom modes */
+    if (SDL_SetTextureBlendMode(tex, mode) != 0)
+        SDL_SetTextureBlendMode(tex, SDL_BLENDMODE_BLEND);
+}
+
 #define N_FONTS 3
 #define MAX_PTS 256
 
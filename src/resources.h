@@ -23,12 +23,18 @@ void release_images();
 texture retrieve_texture(const char *name);
 texture grid_texture(unsigned char idx);
 void grid_offset(unsigned char idx, int *x, int *y);
+/* Colours of the top-left, top-right, bottom-left and bottom-right
+ * quarters of a cell, in RGBA8888; found once when the grid is loaded */
+const Uint32 *grid_colours(unsigned char idx);
 texture temp_texture(SDL_Texture *sdl_tex);
 void render_texture(texture t, SDL_Rect *dim);
 void render_texture_ex(texture t, SDL_Rect *dim,
     double a, SDL_Point *c, SDL_RendererFlip f);
 void render_texture_scaled(texture t, double x, double y, double scale);
 void render_texture_alpha(texture t, SDL_Rect *dim, int alpha);
+/* Makes a render target blend correctly onto others;
+ * its contents are multiplied by alpha when they are drawn onto it */
+void set_premultiplied(SDL_Texture *tex);
 
 #define FONT_ITALIC     0
 #define FONT_UPRIGHT    1
@@ -0,0 +1,108 @@
+#include "tilemap.h"
+#include "global.h"
+
+#include <math.h>
+#include <stdlib.h>
+
+#define CHUNK_PX    (TILEMAP_CHUNK * TILEMAP_CELL)
+
+bool tilemap_baked(sobj *o)
+{
+    return o->tag != 0 && !sobj_needs_update(o);
+}
+
+/* Renders the chunk at (R, C) of the given layer into a new texture.
+ * Sprites can overflow their cells by a few pixels,
+ * hence a ring of neighbouring cells is also drawn, clipped by the texture.
+ * Returns NULL if nothing is drawn. */
+static SDL_Texture *bake_chunk(sim *s, const texture *grid_tex,
+    int layer, int R, int C)
+{
+    int r0 = R * TILEMAP_CHUNK - 1, r1 = (R + 1) * TILEMAP_CHUNK + 1,
+        c0 = C * TILEMAP_CHUNK - 1, c1 = (C + 1) * TILEMAP_CHUNK + 1;
+    if (r0 < 0) r0 = 0;
+    if (c0 < 0) c0 = 0;
+    if (r1 > s->grows) r1 = s->grows;
+    if (c1 > s->gcols) c1 = s->gcols;
+
+    SDL_Texture *ret = NULL;
+    int r, c;
+    for (r = r0; r < r1; ++r)
+        for (c = c0; c < c1; ++c) {
+            sobj *o = &sim_grid(s, r, c);
+            if (!tilemap_baked(o) || (o->tag >= OBJID_DRAW_AFTER) != layer)
+                continue;
+            if (ret == NULL) {
+                ret = SDL_CreateTexture(g_renderer, SDL_PIXELFORMAT_RGBA8888,
+                    SDL_TEXTUREACCESS_TARGET, CHUNK_PX, CHUNK_PX);
+                if (ret == NULL) return NULL;
+                set_premultiplied(ret);
+                SDL_SetRenderTarget(g_renderer, ret);
+                SDL_SetRenderDrawColor(g_renderer, 0, 0, 0, 0);
+                SDL_RenderClear(g_renderer);
+            }
+            render_texture_scaled(grid_tex[o->tag],
+                iround(((int)o->x - C * TILEMAP_CHUNK + o->tx) * TILEMAP_CELL),
+                iround(((int)o->y - R * TILEMAP_CHUNK + o->ty) * TILEMAP_CELL),
+                1);
+        }
+    return ret;
+}
+
+tilemap *tilemap_create(sim *s, const texture *grid_tex)
+{
+    tilemap *this = malloc(sizeof(tilemap));
+    this->rows = (s->grows + TILEMAP_CHUNK - 1) / TILEMAP_CHUNK;
+    this->cols = (s->gcols + TILEMAP_CHUNK - 1) / TILEMAP_CHUNK;
+
+    /* Chunks are magnified; keep the pixels sharp */
+    SDL_Texture *last_target = SDL_GetRenderTarget(g_renderer);
+    SDL_SetHint(SDL_HINT_RENDER_SCALE_QUALITY, "0");
+    int l, i;
+    for (l = 0; l < 2; ++l) {
+        this->tex[l] = malloc(sizeof(SDL_Texture *) * this->rows * this->cols);
+        for (i = 0; i < this->rows * this->cols; ++i)
+            this->tex[l][i] = bake_chunk(s, grid_tex,
+                l, i / this->cols, i % this->cols);
+    }
+    SDL_SetHint(SDL_HINT_RENDER_SCALE_QUALITY, "1");
+    SDL_SetRenderTarget(g_renderer, last_target);
+
+    return this;
+}
+
+void tilemap_drop(tilemap *this)
+{
+    int l, i;
+    for (l = 0; l < 2; ++l) {
+        for (i = 0; i < this->rows * this->cols; ++i)
+            if (this->tex[l][i] != NULL) SDL_DestroyTexture(this->tex[l][i]);
+        free(this->tex[l]);
+    }
+    free(this);
+}
+
+void tilemap_draw(tilemap *this, int layer, int w, int h,
+    double ox, double oy, double cell_px)
+{
+    double chunk_px = TILEMAP_CHUNK * cell_px;
+    /* Only chunks intersecting the target area */
+    int rmin = floor(-oy / chunk_px), rmax = ceil((h - oy) / chunk_px),
+        cmin = floor(-ox / chunk_px), cmax = ceil((w - ox) / chunk_px);
+    if (rmin < 0) rmin = 0;
+    if (cmin < 0) cmin = 0;
+    if (rmax > this->rows) rmax = this->rows;
+    if (cmax > this->cols) cmax = this->cols;
+
+    int r, c;
+    for (r = rmin; r < rmax; ++r)
+        for (c = cmin; c < cmax; ++c) {
+            SDL_Texture *tex = this->tex[layer][r * this->cols + c];
+            if (tex == NULL) continue;
+            /* Edges are rounded separately so that neighbours meet exactly */
+            int x0 = round(ox + c * chunk_px), x1 = round(ox + (c + 1) * chunk_px),
+                y0 = round(oy + r * chunk_px), y1 = round(oy + (r + 1) * chunk_px);
+            SDL_RenderCopy(g_renderer, tex, NULL,
+                &(SDL_Rect){x0, y0, x1 - x0, y1 - y0});
+        }
+}
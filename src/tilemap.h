@@ -0,0 +1,34 @@
+/* Static grid cells pre-rendered into chunks of textures */
+
+#ifndef _TILEMAP_H
+#define _TILEMAP_H
+
+#include "resources.h"
+#include "sim/sim.h"
+
+#include <SDL.h>
+
+/* Number of cells along each side of a chunk */
+#define TILEMAP_CHUNK   16
+/* Size of a cell in the baked textures, in pixels; same as grid sprites */
+#define TILEMAP_CELL    16
+
+typedef struct _tilemap {
+    int rows, cols;     /* Number of chunks */
+    /* Chunks in row-major order, one list for each layer
+     * (below and above the protagonist); NULL if a chunk is empty */
+    SDL_Texture **tex[2];
+} tilemap;
+
+/* Bakes all cells that never change; should be called from the main thread */
+tilemap *tilemap_create(sim *s, const texture *grid_tex);
+void tilemap_drop(tilemap *this);
+/* Whether the cell is baked; others should be drawn each frame */
+bool tilemap_baked(sobj *o);
+/* (w, h) - size of the target area
+ * (ox, oy) - position of the grid's top-left corner in the target
+ * cell_px - size of a cell in the target */
+void tilemap_draw(tilemap *this, int layer, int w, int h,
+    double ox, double oy, double cell_px);
+
+#endif
@@ -86,7 +86,8 @@ unveil *unveil_create()
         SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_STREAMING, W, H);
     SDL_SetTextureBlendMode(this->tex, SDL_BLENDMODE_BLEND);
 
-    this->val = malloc(W * H * sizeof(float));
+    /* Noise is generated once and then normalized */
+    float *noise = malloc(W * H * sizeof(float));
     int i, j;
     int di = rand() % 1665, dj = rand() % 4073;
     float max = -1e10, min = 1e10;
@@ -97,14 +98,14 @@ unveil *unveil_create()
                 4073 + dj + j * NOISE_SCALE);
             if (max < v) max = v;
             if (min > v) min = v;
+            noise[i * W + j] = v;
         }
-    for (i = 0; i < H; ++i)
-        for (j = 0; j < W; ++j)
-            this->val[i * W + j] = scale((float)perlin(
-                1665 + di + i * NOISE_SCALE,
-                4073 + dj + j * NOISE_SCALE
-            ), min, max, NEIGHBOUR, 1 - NEIGHBOUR);
+    this->val = malloc(W * H);
+    for (i = 0; i < W * H; ++i)
+        this->val[i] = iround(scale(noise[i], min, max, 0, 255));
+    free(noise);
 
+    this->last_time = this->last_opacity = -1;
     return this;
 }
 
@@ -119,18 +120,31 @@ void unveil_draw(unveil *this, double time, double opacity)
 {
     time = (time < 0.5 ? 4 * time * time * time :
         1 - 4 * (1 - time) * (1 - time) * (1 - time));
-    void *pix;
-    int pitch;
-    SDL_LockTexture(this->tex, NULL, &pix, &pitch);
 
-    int i, j;
-    for (i = 0; i < H; ++i)
-        for (j = 0; j < W; ++j) {
-            float o = (this->val[i * W + j] - time) / NEIGHBOUR;
+    /* Update the texture only if it changes */
+    if (time != this->last_time || opacity != this->last_opacity) {
+        /* Pixel values for all levels of the noise */
+        Uint32 lut[256];
+        int i, j;
+        for (i = 0; i < 256; ++i) {
+            float v = scale(i, 0, 255, NEIGHBOUR, 1 - NEIGHBOUR);
+            float o = (v - time) / NEIGHBOUR;
             o = (o < 0 ? 0 : (o > 1 ? 1 : o)) * opacity;
-            *(Uint32 *)(pix + i * pitch + j * 4) = 0xffffff00 | iround(o * 255);
+            lut[i] = 0xffffff00 | iround(o * 255);
+        }
+
+        void *pix;
+        int pitch;
+        SDL_LockTexture(this->tex, NULL, &pix, &pitch);
+        for (i = 0; i < H; ++i) {
+            Uint32 *row = (Uint32 *)(pix + i * pitch);
+            const unsigned char *val = this->val + i * W;
+            for (j = 0; j < W; ++j) row[j] = lut[val[j]];
         }
+        SDL_UnlockTexture(this->tex);
+        this->last_time = time;
+        this->last_opacity = opacity;
+    }
 
-    SDL_UnlockTexture(this->tex);
     SDL_RenderCopy(g_renderer, this->tex, NULL, NULL);
 }
@@ -7,7 +7,8 @@
 
 typedef struct _unveil {
     SDL_Texture *tex;
-    float *val;
+    unsigned char *val; /* Noise, quantized to 8 bits */
+    double last_time, last_opacity; /* Parameters of the uploaded texture */
 } unveil;
 
 unveil *unveil_create();